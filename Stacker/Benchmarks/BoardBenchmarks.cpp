@@ -0,0 +1,324 @@
+// Microbenchmarks for the Board hot paths. Never initializes SDL video, so it runs fine on a display-less box.
+// Prints one JSON object per line: benchmark, position, iterations, repetitions, ns/op (median and min) and allocations/op.
+//
+// Build it as its own executable next to the game, e.g.:
+//     g++ -std=c++20 -O2 -I.. BoardBenchmarks.cpp $(sdl2-config --cflags --libs) -lSDL2_image -lSDL2_ttf -o BoardBenchmarks
+// Usage: BoardBenchmarks [name filter] [repetitions]
+// Benchmarks that should never touch the heap abort with a message if they do, so a failing exit code catches that too.
+
+#define SDL_MAIN_HANDLED
+#define LIB_TRACK_ALLOCATIONS // counts allocations/op, see Lib::Debug
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "SDL.h"
+#include "../Lib.hpp"
+#include "../Collections.hpp"
+#include "../Debug.hpp"
+#include "../Stacker.hpp"
+
+using namespace Lib;
+using namespace Lib::Collections;
+using namespace Lib::Debug;
+using namespace Stacker;
+
+namespace Stacker::Benchmarks
+{
+	using BenchmarkClock = std::chrono::steady_clock;
+
+	constexpr usize seed = 0x5eed;
+	constexpr int warmupRepetitions = 2;
+	inline volatile int sink = 0; // keeps the optimizer from throwing the benchmarked calls away
+
+	struct Position final
+	{
+	public:
+		const char *name;
+		std::vector<const char *> rows; // top row first, '.' is empty and anything else is a mino of that type
+	};
+
+	const std::vector<Position> positions =
+	{
+		{ "empty", {} },
+		{
+			"tsd",
+			{
+				"..........",
+				"LL........",
+				"L...OO....",
+				"L..ZOOSSII",
+				"JZZZ.SSIII",
+				"JJZ.IIIIII",
+			}
+		},
+		{
+			"quad",
+			{
+				"IIIIIIIII.",
+				"JJJLLLSSS.",
+				"ZZZTTTOOO.",
+				"IIIIJJJJL.",
+			}
+		},
+		{
+			"messy",
+			{
+				"......T...",
+				"..Z..TTT..",
+				".ZZ.OO.J..",
+				".Z..OO.JJJ",
+				"LLL.S..I..",
+				"L..SS.III.",
+				"I.ZZ.I.OO.",
+				"I..ZZI.OO.",
+			}
+		},
+		{
+			"tall",
+			{
+				".....O....",
+				"...Z.O....",
+				"..ZZTTT...",
+				"..Z..T..S.",
+				"LLL....SS.",
+				"L..JJJ.S..",
+				"IIII.J.OO.",
+				"TTT..OOOO.",
+				".T..ZZ.OO.",
+				"SS...ZZI..",
+				".SS....I.J",
+				"...LLL.I.J",
+				"OO.L...IJJ",
+				"OO..ZZ.TTT",
+				"III.IZZ.T.",
+				"JJJIIIIZZ.",
+			}
+		},
+	};
+
+	Matrix<TetrominoType> MakeBoardState(const Position &position)
+	{
+		Matrix<TetrominoType> result = Matrix<TetrominoType>(Board::height, Board::width, TetrominoType::None);
+		usize rowCount = position.rows.size();
+
+		for (usize i = 0; i < rowCount; ++i)
+		{
+			const char *row = position.rows[i];
+
+			for (usize column = 0; column < static_cast<usize>(Board::width); ++column)
+			{
+				result[usize2 { rowCount - 1 - i, column }] = row[column] == '.' ? TetrominoType::None : static_cast<TetrominoType>(row[column]);
+			}
+		}
+
+		return result;
+	}
+
+	struct Benchmark final
+	{
+	public:
+		const char *name;
+		usize batchSize; // operations timed between two untimed resets of the board
+		usize batches;
+		void (*setup)(Board &board, const Matrix<TetrominoType> &boardState);
+		void (*run)(Board &board, usize batchSize);
+		bool allocationFree = true; // once warmed up, fails the run if it allocates anyway
+	};
+
+	void ResetBoard(Board &board, const Matrix<TetrominoType> &boardState)
+	{
+		board.SetBoardState(boardState);
+	}
+
+	void ResetBoardAndDrop(Board &board, const Matrix<TetrominoType> &boardState)
+	{
+		board.SetBoardState(boardState);
+		board.SoftDropPiece(std::numeric_limits<int>::max());
+	}
+
+	const std::vector<Benchmark> benchmarks =
+	{
+		{
+			"IsOccupied", 1024, 64, ResetBoard,
+			[](Board &board, usize batchSize) -> void
+			{
+				TetrominoState state = board.GetTetrominoState();
+				int result = 0;
+
+				for (usize i = 0; i < batchSize; ++i)
+				{
+					result += board.IsOccupied(state - int2 { 0, static_cast<int>(i % 24) }) ? 1 : 0;
+				}
+
+				sink = result;
+			}
+		},
+		{
+			"MovePiece/Step", 1024, 64, ResetBoard,
+			[](Board &board, usize batchSize) -> void
+			{
+				for (usize i = 0; i < batchSize; ++i)
+				{
+					board.MovePiece((i & 2) != 0 ? 1 : -1);
+				}
+
+				sink = board.GetTetrominoState()[0].x;
+			}
+		},
+		{
+			"MovePiece/Wall", 1024, 64, ResetBoard,
+			[](Board &board, usize batchSize) -> void
+			{
+				for (usize i = 0; i < batchSize; ++i)
+				{
+					board.MovePiece((i & 1) != 0 ? Board::width : -Board::width);
+				}
+
+				sink = board.GetTetrominoState()[0].x;
+			}
+		},
+		{
+			"RotatePiece", 64, 256, ResetBoardAndDrop, // on the stack, so the kick tables actually get walked
+			[](Board &board, usize batchSize) -> void
+			{
+				for (usize i = 0; i < batchSize; ++i)
+				{
+					board.RotatePiece((i & 4) != 0 ? RotateDirection::Counterclockwise : RotateDirection::Clockwise);
+				}
+
+				sink = board.GetTetrominoState()[0].y;
+			}
+		},
+		{
+			"HardDropPiece", 8, 512, ResetBoard, // includes LockAndMoveNext
+			[](Board &board, usize batchSize) -> void
+			{
+				for (usize i = 0; i < batchSize; ++i)
+				{
+					board.HardDropPiece();
+				}
+
+				sink = static_cast<int>(board.GetScore());
+			}
+		},
+		{
+			"CalculateGhostPositions", 1024, 64, ResetBoard,
+			[](Board &board, usize batchSize) -> void
+			{
+				int result = 0;
+
+				for (usize i = 0; i < batchSize; ++i)
+				{
+					result += board.CalculateGhostPositions()[0].y;
+				}
+
+				sink = result;
+			}
+		},
+		{
+			"CalculateClearedLines", 1024, 64, ResetBoardAndDrop,
+			[](Board &board, usize batchSize) -> void
+			{
+				int result = 0;
+
+				for (usize i = 0; i < batchSize; ++i)
+				{
+					result += static_cast<int>(board.CalculateClearedLines().size());
+				}
+
+				sink = result;
+			}
+		},
+	};
+
+	struct Measurement final
+	{
+	public:
+		double nanoseconds;
+		usize allocations;
+	};
+
+	Measurement Measure(const Benchmark &benchmark, Board &board, const Matrix<TetrominoType> &boardState, bool audited)
+	{
+		Measurement result = { 0.0, 0 };
+
+		for (usize i = 0; i < benchmark.batches; ++i)
+		{
+			benchmark.setup(board, boardState);
+			Allocation::NextScratchFrame(); // a batch stands in for a frame
+			AllocationScope allocations = AllocationScope();
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+
+			if (audited)
+			{
+				NoAllocationScope audit = NoAllocationScope(benchmark.name);
+				benchmark.run(board, benchmark.batchSize);
+			}
+			else
+			{
+				benchmark.run(board, benchmark.batchSize);
+			}
+
+			BenchmarkClock::time_point end = BenchmarkClock::now();
+			result.allocations += allocations.GetCounts().allocations;
+			result.nanoseconds += std::chrono::duration<double, std::nano>(end - start).count();
+		}
+
+		return result;
+	}
+
+	void Run(const Benchmark &benchmark, const Position &position, int repetitions)
+	{
+		Matrix<TetrominoType> boardState = MakeBoardState(position);
+		Board board = Board(seed);
+		usize operations = benchmark.batchSize * benchmark.batches;
+		std::vector<double> nanosecondsPerOperation = std::vector<double>();
+		usize allocations = 0;
+
+		for (int i = 0; i < warmupRepetitions; ++i)
+		{
+			Measure(benchmark, board, boardState, false);
+		}
+
+		for (int i = 0; i < repetitions; ++i)
+		{
+			Measurement measurement = Measure(benchmark, board, boardState, benchmark.allocationFree);
+			nanosecondsPerOperation.push_back(measurement.nanoseconds / static_cast<double>(operations));
+			allocations += measurement.allocations;
+		}
+
+		std::sort(nanosecondsPerOperation.begin(), nanosecondsPerOperation.end());
+
+		std::cout << "{\"benchmark\":\"" << benchmark.name << "\",\"position\":\"" << position.name << "\",\"iterations\":" << operations <<
+			",\"repetitions\":" << repetitions << ",\"ns_per_op\":" << nanosecondsPerOperation[nanosecondsPerOperation.size() / 2] <<
+			",\"min_ns_per_op\":" << nanosecondsPerOperation.front() << ",\"allocs_per_op\":" <<
+			static_cast<double>(allocations) / static_cast<double>(operations * static_cast<usize>(repetitions)) << "}\n";
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	using namespace Stacker::Benchmarks;
+
+	const char *filter = argc > 1 ? argv[1] : "";
+	int repetitions = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 10;
+
+	for (const Benchmark &benchmark : benchmarks)
+	{
+		if (std::strstr(benchmark.name, filter) == nullptr)
+		{
+			continue;
+		}
+
+		for (const Position &position : positions)
+		{
+			Run(benchmark, position, repetitions);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,261 @@
+// Render throughput benchmark and golden image check. Draws into an offscreen surface through SDL's software renderer,
+// with the dummy video driver, so it needs no display at all.
+// Prints one JSON object per line per phase: benchmark, frames, repetitions, ns/frame (median and min).
+//
+// Build it as its own executable next to the game, e.g.:
+//     g++ -std=c++20 -O2 -I.. RenderBenchmarks.cpp $(sdl2-config --cflags --libs) -lSDL2_image -lSDL2_ttf -o RenderBenchmarks
+// Usage: RenderBenchmarks [--assets <dir containing Images/ and Fonts/>] [--frames n] [--repetitions n]
+//                         [--screenshot out.png] [--golden expected.png] [--tolerance channel difference]
+// Exits with 1 when --golden is given and the last frame differs from it, so CI can use it as a regression test.
+
+#define SDL_MAIN_HANDLED
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "SDL.h"
+#include "SDL_image.h"
+#include "SDL_ttf.h"
+#include "../Lib.hpp"
+#include "../Collections.hpp"
+#include "../Time.hpp"
+#include "../SdlLib.hpp"
+#include "../Stacker.hpp"
+
+using namespace Lib;
+using namespace Lib::Sdl;
+using namespace Lib::Sdl::Text;
+using namespace Stacker;
+
+namespace Stacker::Benchmarks
+{
+	using BenchmarkClock = std::chrono::steady_clock;
+
+	constexpr int width = 1920 * 4 / 5;
+	constexpr int height = 1080 * 4 / 5;
+	constexpr usize seed = 0x5eed;
+	constexpr int droppedPieces = 12; // so the frame has a stack, a hold piece and some text rather than an empty board
+	constexpr int warmupRepetitions = 2;
+
+	struct Options final
+	{
+	public:
+		string assets = "Assets/";
+		int frames = 200;
+		int repetitions = 10;
+		const char *screenshot = nullptr;
+		const char *golden = nullptr;
+		int tolerance = 0;
+	};
+
+	Options ParseOptions(int argc, char *argv[])
+	{
+		Options result = Options();
+
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			if (std::strcmp(argv[i], "--assets") == 0)
+			{
+				result.assets = argv[i + 1];
+			}
+			else if (std::strcmp(argv[i], "--frames") == 0)
+			{
+				result.frames = std::max(std::atoi(argv[i + 1]), 1);
+			}
+			else if (std::strcmp(argv[i], "--repetitions") == 0)
+			{
+				result.repetitions = std::max(std::atoi(argv[i + 1]), 1);
+			}
+			else if (std::strcmp(argv[i], "--screenshot") == 0)
+			{
+				result.screenshot = argv[i + 1];
+			}
+			else if (std::strcmp(argv[i], "--golden") == 0)
+			{
+				result.golden = argv[i + 1];
+			}
+			else if (std::strcmp(argv[i], "--tolerance") == 0)
+			{
+				result.tolerance = std::atoi(argv[i + 1]);
+			}
+		}
+
+		return result;
+	}
+
+	void Report(const char *name, int frames, std::vector<double> &nanosecondsPerFrame)
+	{
+		std::sort(nanosecondsPerFrame.begin(), nanosecondsPerFrame.end());
+
+		std::cout << "{\"benchmark\":\"" << name << "\",\"width\":" << width << ",\"height\":" << height << ",\"frames\":" << frames <<
+			",\"repetitions\":" << nanosecondsPerFrame.size() << ",\"ns_per_frame\":" << nanosecondsPerFrame[nanosecondsPerFrame.size() / 2] <<
+			",\"min_ns_per_frame\":" << nanosecondsPerFrame.front() << "}\n";
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	using namespace Stacker::Benchmarks;
+
+	Options options = ParseOptions(argc, argv);
+
+	std::atexit([]() -> void
+	{
+		TTF_Quit();
+		IMG_Quit();
+		SDL_Quit();
+	});
+
+	UseDummyVideoDriver();
+	SDL_Init(SDL_INIT_VIDEO);
+	IMG_Init(IMG_INIT_PNG);
+	TTF_Init();
+	assetPath = options.assets + "Images/";
+	fontPath = options.assets + "Fonts/";
+
+	// the renderer has to go before the surface it draws into, and the textures before the renderer
+	Surface surface = {};
+	Renderer renderer = {};
+
+	if (CreateHeadlessRenderer(width, height, surface, renderer) != 0)
+	{
+		std::cerr << "Could not create the headless renderer: " << SDL_GetError() << '\n';
+		return 2;
+	}
+
+	std::unordered_map<TetrominoType, Texture> tetrominoTextures = Lib::Collections::Helpers::unordered_map<TetrominoType, Texture>(
+	{
+		{ TetrominoType::I, Texture(renderer, GetPath("I.png")) },
+		{ TetrominoType::J, Texture(renderer, GetPath("J.png")) },
+		{ TetrominoType::L, Texture(renderer, GetPath("L.png")) },
+		{ TetrominoType::O, Texture(renderer, GetPath("O.png")) },
+		{ TetrominoType::S, Texture(renderer, GetPath("S.png")) },
+		{ TetrominoType::T, Texture(renderer, GetPath("T.png")) },
+		{ TetrominoType::Z, Texture(renderer, GetPath("Z.png")) },
+	});
+
+	std::unordered_map<TetrominoType, Texture> ghostTextures = Lib::Collections::Helpers::unordered_map<TetrominoType, Texture>(
+	{
+		{ TetrominoType::I, Texture(renderer, GetPath("Ghost I.png")) },
+		{ TetrominoType::J, Texture(renderer, GetPath("Ghost J.png")) },
+		{ TetrominoType::L, Texture(renderer, GetPath("Ghost L.png")) },
+		{ TetrominoType::O, Texture(renderer, GetPath("Ghost O.png")) },
+		{ TetrominoType::S, Texture(renderer, GetPath("Ghost S.png")) },
+		{ TetrominoType::T, Texture(renderer, GetPath("Ghost T.png")) },
+		{ TetrominoType::Z, Texture(renderer, GetPath("Ghost Z.png")) },
+	});
+
+	Texture gridTexture = Texture(renderer, GetPath("Grid.png"));
+	Texture spawnTexture = Texture(renderer, GetPath("Spawn.png"));
+	Texture clearedTexture = Texture(renderer, GetPath("Cleared.png"));
+	Texture separatorTexture = Texture(renderer, GetPath("Separator.png"));
+	Font lineClearFont = Font(GetFontPath("hun2.ttf"), 36);
+	Font scoreFont = Font(GetFontPath("hun2.ttf"), 24);
+
+	if (!gridTexture || !lineClearFont)
+	{
+		std::cerr << "Could not load the assets from " << options.assets << ": " << SDL_GetError() << '\n';
+		return 2;
+	}
+
+	TextRenderGuide lineClearRenderGuide = TextRenderGuide(int2 { width / 2 - 192, height - 32 * 17 });
+	TextRenderGuide scoreRenderGuide = TextRenderGuide(int2 { width / 2, height - 24 });
+
+	TileMap tileMap = TileMap(RectSize { 32, 32 }, int2 { width / 2 - 160, height - 64 }, int2 { width / 2 - 32 * 10, height - 32 * 19 },
+		int2 { width / 2 + 32 * 6, height - 32 * 19 });
+
+	Board board = Board(seed);
+	board.HoldPiece();
+
+	for (int i = 0; i < droppedPieces; ++i)
+	{
+		board.MovePiece(i % 5 - 2);
+		board.HardDropPiece();
+	}
+
+	renderer.SetRenderDrawColor(0, 0, 0, 255);
+
+	auto renderBoard = [&]() -> void
+	{
+		renderer.RenderClear();
+
+		for (int i = 0; i < Board::width; ++i)
+		{
+			for (int j = 0; j < Board::visibleHeight; ++j)
+			{
+				tileMap.RenderTo(renderer, gridTexture, nullptr, int2 { i, -j });
+			}
+		}
+
+		tileMap.RenderTo(renderer, board, tetrominoTextures, ghostTextures, spawnTexture, clearedTexture, separatorTexture);
+	};
+
+	auto renderText = [&]() -> void
+	{
+		lineClearRenderGuide.RenderTopRightAligned(renderer, lineClearFont, "TRIPLE", SDL_Color { 255, 255, 255, 255 });
+		scoreRenderGuide.RenderTopCenterAligned(renderer, scoreFont, std::to_string(board.GetScore()), SDL_Color { 255, 255, 255, 255 });
+	};
+
+	auto measure = [&](auto &&renderFrame) -> double
+	{
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+
+		for (int i = 0; i < options.frames; ++i)
+		{
+			renderFrame();
+			renderer.RenderPresent(); // flushes the batched commands into the surface
+		}
+
+		BenchmarkClock::time_point end = BenchmarkClock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(options.frames);
+	};
+
+	auto run = [&](const char *name, auto &&renderFrame) -> void
+	{
+		std::vector<double> nanosecondsPerFrame = std::vector<double>();
+
+		for (int i = 0; i < warmupRepetitions; ++i)
+		{
+			measure(renderFrame);
+		}
+
+		for (int i = 0; i < options.repetitions; ++i)
+		{
+			nanosecondsPerFrame.push_back(measure(renderFrame));
+		}
+
+		Report(name, options.frames, nanosecondsPerFrame);
+	};
+
+	run("Board", renderBoard);
+	run("Text", renderText);
+
+	run("Frame", [&]() -> void
+	{
+		renderBoard();
+		renderText();
+	});
+
+	if (options.screenshot != nullptr && surface.SavePng(options.screenshot) != 0)
+	{
+		std::cerr << "Could not write " << options.screenshot << ": " << SDL_GetError() << '\n';
+		return 2;
+	}
+
+	if (options.golden != nullptr)
+	{
+		Surface golden = Surface(string(options.golden));
+		long long differentPixels = CountDifferentPixels(surface, golden, options.tolerance);
+
+		if (differentPixels != 0)
+		{
+			std::cerr << "Frame differs from " << options.golden << " in " << differentPixels << " pixels (-1 means the size differs)\n";
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -4,10 +4,17 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <span>
 #include <vector>
 #include <memory>
+#include <iterator>
 #include <algorithm>
 #include <initializer_list>
+#include <type_traits>
+#include <cstring>
+#include <istream>
+#include <ostream>
 
 #include "Lib.hpp"
 
@@ -29,6 +36,25 @@ namespace Lib::Collections::Helpers
 		};
 	}
 
+	/// @brief Moves count values into uninitialized memory at destination and ends the lifetimes of the originals, which for trivially
+	/// copyable types is just a memcpy.
+	template <typename T>
+	void Relocate(T *source, usize count, T *destination) noexcept(std::is_nothrow_move_constructible_v<T>)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			if (count > 0)
+			{
+				std::memcpy(static_cast<void *>(destination), static_cast<const void *>(source), count * sizeof(T));
+			}
+		}
+		else
+		{
+			std::uninitialized_move_n(source, count, destination);
+			std::destroy_n(source, count);
+		}
+	}
+
 	template <typename TCollection, typename TFunc>
 	constexpr void Iterate(TCollection &&collection, TFunc &&func)
 	{
@@ -253,21 +279,12 @@ namespace Lib::Collections
 		TSize actualCapacity;
 		TAllocator allocator;
 
-		void Resize()
+		// a cache line's worth, or 4 for the bigger types
+		static constexpr TSize initialCapacity = static_cast<TSize>(std::max(static_cast<usize>(4), 64 / sizeof(T)));
+
+		void Grow(TSize minCapacity)
 		{
-			if (ptr != nullptr)
-			{
-				T *oldPtr = ptr;
-				TSize oldCapacity = actualCapacity;
-				actualCapacity = actualCapacity * 3 / 2 + 1;
-				ptr = allocator.allocate(actualCapacity);
-				std::uninitialized_copy(oldPtr, oldPtr + count, ptr);
-				allocator.deallocate(oldPtr, oldCapacity);
-			}
-			else
-			{
-				ptr = allocator.allocate(1);
-			}
+			Resize(std::max({ minCapacity, static_cast<TSize>(actualCapacity * 3 / 2 + 1), initialCapacity }));
 		}
 
 	public:
@@ -318,11 +335,16 @@ namespace Lib::Collections
 		}
 
 		constexpr List(List &&other) noexcept(noexcept(TAllocator(std::move(other.allocator)))) :
-			ptr(std::exchange(other.ptr, nullptr)), count(other.count), actualCapacity(other.actualCapacity), 
-			allocator(std::move(other.allocator)) {}
+			ptr(std::exchange(other.ptr, nullptr)), count(std::exchange(other.count, TSize())), 
+			actualCapacity(std::exchange(other.actualCapacity, TSize())), allocator(std::move(other.allocator)) {}
 
 		constexpr List &operator=(const List &other)
 		{
+			if (this == std::addressof(other))
+			{
+				return *this;
+			}
+
 			if (ptr != nullptr)
 			{
 				std::destroy(ptr, ptr + count);
@@ -333,7 +355,7 @@ namespace Lib::Collections
 			count = other.count;
 			actualCapacity = other.actualCapacity;
 			ptr = allocator.allocate(other.actualCapacity);
-			std::uninitialized_copy(other.ptr, other.ptr + other.actualCapacity, ptr);
+			std::uninitialized_copy(other.ptr, other.ptr + other.count, ptr);
 			return *this;
 		}
 
@@ -346,8 +368,8 @@ namespace Lib::Collections
 			}
 
 			allocator = std::move(other.allocator);
-			count = other.count;
-			actualCapacity = other.actualCapacity;
+			count = std::exchange(other.count, TSize());
+			actualCapacity = std::exchange(other.actualCapacity, TSize());
 			ptr = std::exchange(other.ptr, nullptr);
 			return *this;
 		}
@@ -392,25 +414,32 @@ namespace Lib::Collections
 			return ptr + count;
 		}
 
+		// Reallocates to exactly newCapacity, dropping the values past it, and moves the rest over.
 		constexpr void Resize(TSize newCapacity)
 		{
-			if (ptr != nullptr)
+			if (newCapacity < count)
 			{
-				T *oldPtr = ptr;
-				TSize oldCapacity = actualCapacity;
-				ptr = allocator.allocate(newCapacity);
+				std::destroy(ptr + newCapacity, ptr + count);
+				count = newCapacity;
+			}
 
-				if (newCapacity < count)
-				{
-					count = newCapacity;
-				}
+			T *newPtr = newCapacity > TSize() ? allocator.allocate(newCapacity) : nullptr;
 
-				std::uninitialized_copy(oldPtr, oldPtr + count, ptr);
-				allocator.deallocate(oldPtr, oldCapacity);
+			if (ptr != nullptr)
+			{
+				Relocate(ptr, static_cast<usize>(count), newPtr);
+				allocator.deallocate(ptr, actualCapacity);
 			}
-			else
+
+			ptr = newPtr;
+			actualCapacity = newCapacity;
+		}
+
+		constexpr void Reserve(TSize minCapacity)
+		{
+			if (minCapacity > actualCapacity)
 			{
-				ptr = allocator.allocate(newCapacity);
+				Resize(minCapacity);
 			}
 		}
 
@@ -419,10 +448,15 @@ namespace Lib::Collections
 		{
 			if (size() >= capacity())
 			{
-				Resize();
+				T value = T(std::forward<TParams>(params)...); // params may refer to one of our own values, which growing moves
+				Grow(count + 1);
+				new (ptr + count) T(std::move(value));
 			}
-			
-			new (ptr + count) T(std::forward<TParams>(params)...);
+			else
+			{
+				new (ptr + count) T(std::forward<TParams>(params)...);
+			}
+
 			++count;
 		}
 
@@ -431,9 +465,9 @@ namespace Lib::Collections
 		{
 			TSize length = static_cast<TSize>(std::distance(begin, end));
 
-			if (size() + length < capacity())
+			if (size() + length > capacity())
 			{
-				Resize(size() + length);
+				Grow(size() + length);
 			}
 
 			std::uninitialized_copy(begin, end, this->end());
@@ -443,7 +477,7 @@ namespace Lib::Collections
 		template <typename TIterator>
 		constexpr void AddRange(TIterator begin, TSize length)
 		{
-			AddRange(begin, std::advance(begin, length));
+			AddRange(begin, std::next(begin, length));
 		}
 
 		template <typename TIterable>
@@ -498,6 +532,7 @@ namespace Lib::Collections
 			{
 				TSize length = lastIndex - firstIndex;
 				std::move(ptr + lastIndex, end(), ptr + firstIndex);
+				std::destroy(end() - length, end());
 				count -= length;
 				return true;
 			}
@@ -511,8 +546,12 @@ namespace Lib::Collections
 		{
 			if (index < count && index >= 0)
 			{
-				std::destroy_at(ptr + index);
-				std::uninitialized_copy(ptr + index + 1, ptr + count, ptr + index); // only one element is actually uninitialized though...
+				if (index + 1 < count)
+				{
+					ptr[index] = std::move(ptr[count - 1]);
+				}
+
+				std::destroy_at(ptr + count - 1);
 				--count;
 				return true;
 			}
@@ -535,22 +574,22 @@ namespace Lib::Collections
 
 		constexpr std::reverse_iterator<const T *> rbegin() const noexcept
 		{
-			return std::reverse_iterator<const T *>(ptr + count - 1);
+			return std::reverse_iterator<const T *>(end());
 		}
 		
 		constexpr std::reverse_iterator<T *> rbegin() noexcept
 		{
-			return std::reverse_iterator<T *>(ptr + count - 1);
+			return std::reverse_iterator<T *>(end());
 		}
 
 		constexpr std::reverse_iterator<const T *> rend() const noexcept
 		{
-			return std::reverse_iterator<const T *>(ptr - 1);
+			return std::reverse_iterator<const T *>(begin());
 		}
 
 		constexpr std::reverse_iterator<T *> rend() noexcept
 		{
-			return std::reverse_iterator<T *>(ptr - 1);
+			return std::reverse_iterator<T *>(begin());
 		}
 
 		constexpr const T &operator[](TSize index) const noexcept
@@ -565,20 +604,16 @@ namespace Lib::Collections
 
 		friend std::istream &operator>>(std::istream &stream, List &values)
 		{
-			if (values.ptr != nullptr)
-			{
-				std::destroy(values.ptr, values.ptr + count);
-				allocator.deallocate(values.ptr, values.actualCapacity);
-			}
-
-			stream >> values.count;
-			values.actualCapacity = values.count;
+			TSize length = TSize();
+			stream >> length;
+			values.Clear();
+			values.Reserve(length);
 			
-			for (T &value : values)
+			for (TSize i = TSize(); i < length; ++i)
 			{
 				T temp = {};
 				stream >> temp;
-				new (std::addressof(value)) T(std::move(temp));
+				values.Add(std::move(temp));
 			}
 
 			return stream;
@@ -604,20 +639,359 @@ namespace Lib::Collections
 		}
 	};
 
+	/// @brief A List that keeps its first InlineCapacity values inside itself and only goes to the heap once it outgrows them,
+	/// for the many short lists (kicks, cleared rows, placements) that would otherwise cost an allocation each.
+	template <typename T, const usize InlineCapacity, typename TAllocator = std::allocator<T>, typename TSize = usize> requires (InlineCapacity > 0)
+	class SmallList final
+	{
+	private:
+		T *ptr; // inlineValues until the values outgrow it
+		TSize count;
+		TSize actualCapacity;
+		[[no_unique_address]] TAllocator allocator;
+		alignas(T) byte inlineValues[InlineCapacity * sizeof(T)];
+
+		T *GetInlineValues() noexcept
+		{
+			return reinterpret_cast<T *>(inlineValues);
+		}
+
+		void Grow(TSize minCapacity)
+		{
+			Reserve(std::max(minCapacity, static_cast<TSize>(actualCapacity * 2)));
+		}
+
+		// Leaves the values behind uninitialized.
+		void ReleaseHeap() noexcept
+		{
+			if (!IsInline())
+			{
+				allocator.deallocate(ptr, actualCapacity);
+				ptr = GetInlineValues();
+				actualCapacity = static_cast<TSize>(InlineCapacity);
+			}
+		}
+
+		// Takes other's values, stealing its heap buffer if it has one, and leaves it empty. Expects this to be empty and inline.
+		void TakeFrom(SmallList &other) noexcept(std::is_nothrow_move_constructible_v<T>)
+		{
+			if (other.IsInline())
+			{
+				Relocate(other.ptr, static_cast<usize>(other.count), ptr);
+			}
+			else
+			{
+				ptr = std::exchange(other.ptr, other.GetInlineValues());
+				actualCapacity = std::exchange(other.actualCapacity, static_cast<TSize>(InlineCapacity));
+			}
+
+			count = std::exchange(other.count, TSize());
+		}
+
+	public:
+		using value_type = T;
+		using allocator_type = TAllocator;
+		using size_type = TSize;
+		using iterator = T *;
+		using const_iterator = const T *;
+
+		SmallList() noexcept(noexcept(TAllocator())) : ptr(GetInlineValues()), count(TSize()), actualCapacity(static_cast<TSize>(InlineCapacity)), 
+			allocator() {}
+
+		explicit SmallList(const TAllocator &allocator) noexcept(noexcept(TAllocator(allocator))) : ptr(GetInlineValues()), count(TSize()), 
+			actualCapacity(static_cast<TSize>(InlineCapacity)), allocator(allocator) {}
+
+		template <typename TIterator>
+		SmallList(TIterator first, TIterator last, const TAllocator &allocator = TAllocator()) : SmallList(allocator)
+		{
+			AddRange(first, last);
+		}
+
+		SmallList(std::initializer_list<T> values, const TAllocator &allocator = TAllocator()) : SmallList(allocator)
+		{
+			AddRange(values.begin(), values.end());
+		}
+
+		SmallList(const SmallList &other) : SmallList(other.allocator)
+		{
+			AddRange(other.begin(), other.end());
+		}
+
+		SmallList(SmallList &&other) noexcept(std::is_nothrow_move_constructible_v<T>) : SmallList(other.allocator)
+		{
+			TakeFrom(other);
+		}
+
+		SmallList &operator=(const SmallList &other)
+		{
+			if (this != std::addressof(other))
+			{
+				Clear();
+				AddRange(other.begin(), other.end());
+			}
+
+			return *this;
+		}
+
+		SmallList &operator=(SmallList &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+		{
+			if (this != std::addressof(other))
+			{
+				Clear();
+				ReleaseHeap();
+				allocator = other.allocator;
+				TakeFrom(other);
+			}
+
+			return *this;
+		}
+
+		TSize size() const noexcept
+		{
+			return count;
+		}
+
+		TSize capacity() const noexcept
+		{
+			return actualCapacity;
+		}
+
+		bool IsEmpty() const noexcept
+		{
+			return count == TSize();
+		}
+
+		// Whether the values still live in the list itself.
+		bool IsInline() const noexcept
+		{
+			return ptr == reinterpret_cast<const T *>(inlineValues);
+		}
+
+		const T *data() const noexcept
+		{
+			return ptr;
+		}
+
+		T *data() noexcept
+		{
+			return ptr;
+		}
+
+		const T *cbegin() const noexcept
+		{
+			return ptr;
+		}
+
+		const T *cend() const noexcept
+		{
+			return ptr + count;
+		}
+
+		const T *begin() const noexcept
+		{
+			return ptr;
+		}
+
+		T *begin() noexcept
+		{
+			return ptr;
+		}
+
+		const T *end() const noexcept
+		{
+			return ptr + count;
+		}
+
+		T *end() noexcept
+		{
+			return ptr + count;
+		}
+
+		void Reserve(TSize minCapacity)
+		{
+			if (minCapacity > actualCapacity)
+			{
+				T *newPtr = allocator.allocate(minCapacity);
+				Relocate(ptr, static_cast<usize>(count), newPtr);
+				ReleaseHeap();
+				ptr = newPtr;
+				actualCapacity = minCapacity;
+			}
+		}
+
+		template <typename ...TParams>
+		T &Add(TParams &&...params)
+		{
+			if (count >= actualCapacity)
+			{
+				T value = T(std::forward<TParams>(params)...); // params may refer to one of our own values, which growing moves
+				Grow(count + 1);
+				new (ptr + count) T(std::move(value));
+			}
+			else
+			{
+				new (ptr + count) T(std::forward<TParams>(params)...);
+			}
+
+			return ptr[count++];
+		}
+
+		template <typename TIterator>
+		void AddRange(TIterator first, TIterator last)
+		{
+			TSize length = static_cast<TSize>(std::distance(first, last));
+
+			if (count + length > actualCapacity)
+			{
+				Grow(count + length);
+			}
+
+			std::uninitialized_copy(first, last, end());
+			count += length;
+		}
+
+		template <typename TIterable>
+		void AddRange(const TIterable &iterable)
+		{
+			AddRange(std::begin(iterable), std::end(iterable));
+		}
+
+		bool Remove(TSize index)
+		{
+			if (index < count)
+			{
+				std::move(ptr + index + 1, end(), ptr + index);
+				std::destroy_at(end() - 1);
+				--count;
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		bool RemoveAtSwapBack(TSize index)
+		{
+			if (index < count)
+			{
+				if (index + 1 < count)
+				{
+					ptr[index] = std::move(ptr[count - 1]);
+				}
+
+				std::destroy_at(end() - 1);
+				--count;
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		void RemoveLast() noexcept
+		{
+			std::destroy_at(end() - 1);
+			--count;
+		}
+
+		// Keeps the capacity, heap or not.
+		void Clear() noexcept
+		{
+			std::destroy(begin(), end());
+			count = TSize();
+		}
+
+		const T &operator[](TSize index) const noexcept
+		{
+			return ptr[index];
+		}
+
+		T &operator[](TSize index) noexcept
+		{
+			return ptr[index];
+		}
+
+		operator std::span<const T>() const noexcept
+		{
+			return std::span<const T>(ptr, static_cast<usize>(count));
+		}
+
+		~SmallList()
+		{
+			Clear();
+			ReleaseHeap();
+		}
+	};
+
+	// Walks the rows of a Matrix in their logical order, which isn't the order they're stored in.
+	template <typename T>
+	class MatrixRowIterator final
+	{
+	private:
+		T *values;
+		const usize *rowIndex;
+		usize stride;
+
+	public:
+		using value_type = std::span<T>;
+		using difference_type = std::ptrdiff_t;
+		using reference = std::span<T>;
+		using iterator_category = std::forward_iterator_tag;
+
+		constexpr MatrixRowIterator() noexcept = default;
+		constexpr MatrixRowIterator(T *values, const usize *rowIndex, usize stride) noexcept : values(values), rowIndex(rowIndex), stride(stride) {}
+
+		constexpr std::span<T> operator*() const noexcept
+		{
+			return std::span<T>(values + *rowIndex * stride, stride);
+		}
+
+		constexpr MatrixRowIterator &operator++() noexcept
+		{
+			++rowIndex;
+			return *this;
+		}
+
+		constexpr MatrixRowIterator operator++(int) noexcept
+		{
+			MatrixRowIterator result = *this;
+			++rowIndex;
+			return result;
+		}
+
+		constexpr bool operator==(const MatrixRowIterator &other) const noexcept
+		{
+			return rowIndex == other.rowIndex;
+		}
+	};
+
+	// Row-major in one contiguous buffer. Rows are reached through an index, so reordering them (line clears) only moves
+	// indices around and never the rows themselves.
 	template <typename T>
 	class Matrix final
 	{
+		static_assert(!std::is_same_v<T, bool>, "std::vector<bool> can't hand out spans, use a char or an enum instead");
+
 	private:
-		std::vector<std::vector<T>> values; // fuck std::vector<bool>...
+		std::vector<T> values;
+		std::vector<usize> rowIndices; // logical row -> row in values
+		usize rows;
+		usize columns; // also the row stride
 
 	public:
 		using value_type = T;
+		using iterator = MatrixRowIterator<T>;
+		using const_iterator = MatrixRowIterator<const T>;
 
-		constexpr Matrix() noexcept = default;
+		constexpr Matrix() noexcept : values(), rowIndices(), rows(0), columns(0) {}
 
-		constexpr Matrix(usize rows, usize columns) : values(std::vector<std::vector<T>>(rows, std::vector<T>(columns))) {}
+		constexpr Matrix(usize rows, usize columns) : values(std::vector<T>(rows * columns)), rowIndices(IdentityRowIndices(rows)), rows(rows),
+			columns(columns) {}
 
-		constexpr Matrix(usize rows, usize columns, const T &value) : values(std::vector<std::vector<T>>(rows, std::vector<T>(columns, value))) {}
+		constexpr Matrix(usize rows, usize columns, const T &value) : values(std::vector<T>(rows * columns, value)),
+			rowIndices(IdentityRowIndices(rows)), rows(rows), columns(columns) {}
 
 		template <const usize Rows, const usize Columns>
 		constexpr Matrix(const T(&values)[Rows][Columns]) : Matrix(Rows, Columns)
@@ -626,8 +1000,7 @@ namespace Lib::Collections
 			{
 				for (usize j = 0; j < Columns; ++j)
 				{
-					/*new (std::addressof(this->values[i][j])) T(values[i][j]);*/
-					this->values[i][j] = values[i][j];
+					this->values[i * Columns + j] = values[i][j];
 				}
 			}
 		}
@@ -639,26 +1012,25 @@ namespace Lib::Collections
 			{
 				for (usize j = 0; j < Columns; ++j)
 				{
-					/*new (std::addressof(this->values[i][j])) T(std::move(values[i][j]));*/
-					this->values[i][j] = std::move(values[i][j]);
+					this->values[i * Columns + j] = std::move(values[i][j]);
 				}
 			}
 		}
 
 		constexpr usize size() const noexcept
 		{
-			return values.size() > 0 ? values.size() * values.front().size() : 0;
+			return rows * columns;
 		}
 
 		constexpr usize size(usize dimension) const noexcept
 		{
 			if (dimension == 0)
 			{
-				return values.size();
+				return rows;
 			}
 			else if (dimension == 1)
 			{
-				return values.size() > 0 ? values.front().size() : 0;
+				return columns;
 			}
 			else
 			{
@@ -666,70 +1038,113 @@ namespace Lib::Collections
 			}
 		}
 
-		constexpr std::vector<std::vector<T>>::const_iterator begin() const noexcept
+		constexpr const_iterator begin() const noexcept
 		{
-			return values.begin();
+			return const_iterator(values.data(), rowIndices.data(), columns);
 		}
 
-		constexpr std::vector<std::vector<T>>::iterator begin() noexcept
+		constexpr iterator begin() noexcept
 		{
-			return values.begin();
+			return iterator(values.data(), rowIndices.data(), columns);
 		}
 
-		constexpr std::vector<std::vector<T>>::const_iterator end() const noexcept
+		constexpr const_iterator end() const noexcept
 		{
-			return values.end();
+			return const_iterator(values.data(), rowIndices.data() + rows, columns);
 		}
 
-		constexpr std::vector<std::vector<T>>::iterator end() noexcept
+		constexpr iterator end() noexcept
 		{
-			return values.end();
+			return iterator(values.data(), rowIndices.data() + rows, columns);
+		}
+
+		constexpr std::span<const T> GetRow(usize row) const noexcept
+		{
+			return std::span<const T>(values.data() + rowIndices[row] * columns, columns);
+		}
+
+		constexpr std::span<T> GetRow(usize row) noexcept
+		{
+			return std::span<T>(values.data() + rowIndices[row] * columns, columns);
+		}
+
+		// Every cell in storage order, which only matches the logical order until rows get reordered. Fine for whole-matrix checks.
+		constexpr std::span<const T> GetValues() const noexcept
+		{
+			return std::span<const T>(values);
 		}
 
 		constexpr void ClearRow(usize row) noexcept
 		{
-			for (T &value : values[row])
-			{
-				value = T();
-			}
+			std::span<T> values = GetRow(row);
+			std::fill(values.begin(), values.end(), T());
 		}
 
 		constexpr void MoveRowToLast(usize row) noexcept
 		{
-			std::vector<T> temp = values[row];
-			values.erase(values.begin() + row);
-			values.push_back(std::move(temp));
+			std::rotate(rowIndices.begin() + row, rowIndices.begin() + row + 1, rowIndices.end());
+		}
+
+		/// @brief Clears every row the predicate holds for and moves it to the end, keeping the order of the other rows.
+		/// Done in a single pass over the row indices and without allocating, however many rows match.
+		/// @param predicate Gets the logical row index, GetRow(row) is still valid while it runs
+		/// @return The number of cleared rows
+		template <typename TPredicate>
+		constexpr usize ClearRowsWhere(TPredicate predicate)
+		{
+			usize kept = 0;
+
+			for (usize row = 0; row < rows; ++row)
+			{
+				if (predicate(row))
+				{
+					ClearRow(row);
+				}
+				else
+				{
+					// everything between kept and row is a cleared row, so this keeps the remaining rows in order
+					std::swap(rowIndices[kept], rowIndices[row]);
+					++kept;
+				}
+			}
+
+			return rows - kept;
 		}
 
 		constexpr void InsertRow(usize row, T values[]) noexcept
 		{
-			this->values[row].assign(values, values + size(1));
+			std::copy(values, values + columns, GetRow(row).begin());
 		}
 
 		constexpr void RemoveRow(usize row) noexcept
 		{
-			values.erase(values.begin() + row);
+			usize removed = rowIndices[row];
+			values.erase(values.begin() + removed * columns, values.begin() + (removed + 1) * columns);
+			rowIndices.erase(rowIndices.begin() + row);
+			--rows;
+
+			for (usize &rowIndex : rowIndices)
+			{
+				if (rowIndex > removed)
+				{
+					--rowIndex;
+				}
+			}
 		}
 
 		constexpr void SwapRowToLast(usize row) noexcept
 		{
-			std::swap(values[row], values[size(0) - 1]);
+			std::swap(rowIndices[row], rowIndices[rows - 1]);
 		}
 
 		constexpr void Reverse()
 		{
-			std::reverse(values.begin(), values.end());
+			std::reverse(rowIndices.begin(), rowIndices.end());
 		}
 
 		constexpr void Fill(const T &value)
 		{
-			for (std::vector<T> &row : values)
-			{
-				for (T &val : row)
-				{
-					val = value;
-				}
-			}
+			std::fill(values.begin(), values.end(), value);
 		}
 
 		constexpr void Clear()
@@ -739,40 +1154,29 @@ namespace Lib::Collections
 
 		constexpr bool IsCleared() const noexcept
 		{
-			for (const std::vector<T> &row : values)
-			{
-				for (const T &value : row)
-				{
-					if (value != T())
-					{
-						return false;
-					}
-				}
-			}
-
-			return true;
+			return std::all_of(values.begin(), values.end(), [](const T &value) -> bool { return value == T(); });
 		}
 
 		template <typename TInt> requires std::is_integral_v<TInt>
 		constexpr const T &operator[](const Value2<TInt> &indices) const noexcept
 		{
-			return values[static_cast<usize>(indices.x)][static_cast<usize>(indices.y)];
+			return values[rowIndices[static_cast<usize>(indices.x)] * columns + static_cast<usize>(indices.y)];
 		}
 
 		template <typename TInt> requires std::is_integral_v<TInt>
 		constexpr T &operator[](const Value2<TInt> &indices) noexcept
 		{
-			return values[static_cast<usize>(indices.x)][static_cast<usize>(indices.y)];
+			return values[rowIndices[static_cast<usize>(indices.x)] * columns + static_cast<usize>(indices.y)];
 		}
 
 		constexpr const T &operator[](const usize(&indices)[2]) const noexcept
 		{
-			return values[indices[0]][indices[1]];
+			return values[rowIndices[indices[0]] * columns + indices[1]];
 		}
 
 		constexpr T &operator[](const usize(&indices)[2]) noexcept
 		{
-			return values[indices[0]][indices[1]];
+			return values[rowIndices[indices[0]] * columns + indices[1]];
 		}
 
 		friend std::istream &operator>>(std::istream &stream, Matrix &values)
@@ -780,7 +1184,7 @@ namespace Lib::Collections
 			usize rows;
 			usize columns;
 			stream >> rows >> columns;
-			values.values = std::vector<std::vector<T>>(rows, std::vector<T>(columns));
+			values = Matrix(rows, columns);
 
 			for (usize i = 0; i < rows; ++i)
 			{
@@ -810,6 +1214,19 @@ namespace Lib::Collections
 
 			return stream;
 		}
+
+	private:
+		static constexpr std::vector<usize> IdentityRowIndices(usize rows)
+		{
+			std::vector<usize> result = std::vector<usize>(rows);
+
+			for (usize i = 0; i < rows; ++i)
+			{
+				result[i] = i;
+			}
+
+			return result;
+		}
 	};
 
 	template <typename T>
@@ -838,6 +1255,187 @@ namespace Lib::Collections
 
 	public:
 	};
+
+	// What lock-free containers pad their shared state to, std::hardware_destructive_interference_size isn't everywhere yet.
+	constexpr usize cacheLineSize = 64;
+
+	/// @brief Bounded queue between exactly one producer thread and exactly one consumer thread, without locks. Every operation
+	/// finishes in a bounded number of steps whatever the other thread is doing, and the two sides keep their indices on separate
+	/// cache lines. Capacity must be a power of 2.
+	template <typename T, const usize Capacity> requires (Capacity > 0 && (Capacity & (Capacity - 1)) == 0)
+	class SpscQueue final
+	{
+	private:
+		static constexpr usize mask = Capacity - 1;
+
+		// Only ever increase, the slot is the index masked, so full and empty can be told apart without a spare slot.
+		alignas(cacheLineSize) std::atomic<usize> tail; // written by the producer
+		usize cachedHead; // the producer's last look at head, it only reads the real one when the queue looks full
+		alignas(cacheLineSize) std::atomic<usize> head; // written by the consumer
+		usize cachedTail; // the consumer's last look at tail
+		alignas(cacheLineSize) std::array<T, Capacity> values;
+
+	public:
+		using value_type = T;
+
+		SpscQueue() noexcept(std::is_nothrow_default_constructible_v<T>) : tail(0), cachedHead(0), head(0), cachedTail(0), values() {}
+
+		SpscQueue(const SpscQueue &) = delete;
+		SpscQueue &operator=(const SpscQueue &) = delete;
+
+		static constexpr usize capacity() noexcept
+		{
+			return Capacity;
+		}
+
+		// Exact from either side when the other one is idle, a snapshot otherwise.
+		usize size() const noexcept
+		{
+			return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		}
+
+		bool IsEmpty() const noexcept
+		{
+			return size() == 0;
+		}
+
+		// Producer only. Returns false, leaving value alone, when the queue is full.
+		template <typename TValue>
+		bool TryPush(TValue &&value) noexcept(std::is_nothrow_assignable_v<T &, TValue>)
+		{
+			usize index = tail.load(std::memory_order_relaxed);
+
+			if (index - cachedHead >= Capacity)
+			{
+				cachedHead = head.load(std::memory_order_acquire);
+
+				if (index - cachedHead >= Capacity)
+				{
+					return false;
+				}
+			}
+
+			values[index & mask] = std::forward<TValue>(value);
+			tail.store(index + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// @brief Producer only. Pushes as many of the values as fit, publishing them all at once.
+		/// @return How many were pushed, from the front
+		usize TryPushRange(std::span<const T> range) noexcept(std::is_nothrow_copy_assignable_v<T>)
+		{
+			usize index = tail.load(std::memory_order_relaxed);
+
+			if (index - cachedHead + range.size() > Capacity)
+			{
+				cachedHead = head.load(std::memory_order_acquire);
+			}
+
+			usize count = std::min(range.size(), Capacity - (index - cachedHead));
+
+			for (usize i = 0; i < count; ++i)
+			{
+				values[(index + i) & mask] = range[i];
+			}
+
+			tail.store(index + count, std::memory_order_release);
+			return count;
+		}
+
+		// Consumer only. Returns false, leaving result alone, when the queue is empty.
+		bool TryPop(T &result) noexcept(std::is_nothrow_move_assignable_v<T>)
+		{
+			usize index = head.load(std::memory_order_relaxed);
+
+			if (index == cachedTail)
+			{
+				cachedTail = tail.load(std::memory_order_acquire);
+
+				if (index == cachedTail)
+				{
+					return false;
+				}
+			}
+
+			result = std::move(values[index & mask]);
+			head.store(index + 1, std::memory_order_release);
+			return true;
+		}
+
+		/// @brief Consumer only. Hands everything pushed so far (up to maxCount) to func in order, then frees the slots in one go,
+		/// which is cheaper than popping them one by one.
+		/// @return How many values func got
+		template <typename TFunc>
+		usize Drain(TFunc &&func, usize maxCount = Capacity)
+		{
+			usize index = head.load(std::memory_order_relaxed);
+			cachedTail = tail.load(std::memory_order_acquire);
+			usize count = std::min(cachedTail - index, maxCount);
+
+			for (usize i = 0; i < count; ++i)
+			{
+				func(std::move(values[(index + i) & mask]));
+			}
+
+			head.store(index + count, std::memory_order_release);
+			return count;
+		}
+	};
+
+	/// @brief Hands the latest value from exactly one writer thread to exactly one reader thread, without locks or waiting on either
+	/// side. The writer fills its back slot and publishes it, the reader swaps in whatever was published last. Values published in
+	/// between are simply never seen, which is what you want for state snapshots and not for messages (use SpscQueue for those).
+	template <typename T>
+	class TripleBuffer final
+	{
+	private:
+		static constexpr std::uint8_t indexMask = 3;
+		static constexpr std::uint8_t freshBit = 4; // set on the middle index when the writer published since the reader last swapped
+
+		// Each of the three slots belongs to exactly one of back, middle and front at any time, only middle is ever shared.
+		std::array<T, 3> values;
+		alignas(cacheLineSize) std::atomic<std::uint8_t> middle;
+		alignas(cacheLineSize) std::uint8_t back; // the writer's
+		alignas(cacheLineSize) std::uint8_t front; // the reader's
+
+	public:
+		using value_type = T;
+
+		TripleBuffer() noexcept(std::is_nothrow_default_constructible_v<T>) : values(), middle(1), back(0), front(2) {}
+
+		TripleBuffer(const TripleBuffer &) = delete;
+		TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+		// Writer only. Whatever was last written there, not necessarily the last published value.
+		T &GetBack() noexcept
+		{
+			return values[back];
+		}
+
+		// Writer only. Makes the back slot the latest value and hands the writer another one.
+		void Publish() noexcept
+		{
+			back = middle.exchange(static_cast<std::uint8_t>(back | freshBit), std::memory_order_acq_rel) & indexMask;
+		}
+
+		// Reader only. Takes the latest published value if there's a new one, returns whether there was.
+		bool Update() noexcept
+		{
+			if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+			{
+				return false;
+			}
+
+			front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+			return true;
+		}
+
+		// Reader only. Stays the same until the next Update() that returns true.
+		const T &GetFront() const noexcept
+		{
+			return values[front];
+		}
+	};
 }
 
 #endif // !COLLECTIONS_DEFINED
@@ -5,6 +5,11 @@
 
 #include <iostream>
 #include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "Lib.hpp"
 
 namespace Lib::Debug
 {
@@ -68,6 +73,242 @@ namespace Lib::Debug
 			destructor();
 		}
 	};
+
+	// Define LIB_TRACK_ALLOCATIONS before including this, in the one translation unit that should own the replacement
+	// operator new and delete (the one with main), to have the counts below move at all.
+#ifdef LIB_TRACK_ALLOCATIONS
+	constexpr bool allocationTrackingEnabled = true;
+#else
+	constexpr bool allocationTrackingEnabled = false;
+#endif
+
+	struct AllocationCounts final
+	{
+	public:
+		usize allocations;
+		usize deallocations;
+		usize bytes; // allocated, frees aren't subtracted since plain delete doesn't get told the size
+
+		constexpr AllocationCounts operator-(const AllocationCounts &other) const noexcept
+		{
+			return { allocations - other.allocations, deallocations - other.deallocations, bytes - other.bytes };
+		}
+	};
+
+	inline thread_local AllocationCounts threadAllocationCounts = { 0, 0, 0 };
+
+	// Since the calling thread started.
+	inline AllocationCounts GetThreadAllocationCounts() noexcept
+	{
+		return threadAllocationCounts;
+	}
+
+	/// @brief Counts what the calling thread allocates from its construction on, nested scopes each count everything under them.
+	struct AllocationScope final
+	{
+	private:
+		AllocationCounts start;
+
+	public:
+		AllocationScope() noexcept : start(GetThreadAllocationCounts()) {}
+
+		AllocationCounts GetCounts() const noexcept
+		{
+			return GetThreadAllocationCounts() - start;
+		}
+
+		void Restart() noexcept
+		{
+			start = GetThreadAllocationCounts();
+		}
+	};
+
+	using AllocationFailureHandler = void(*)(const char *name, const AllocationCounts &counts);
+
+	// Called when a NoAllocationScope ends having seen allocations, the default one reports it and aborts.
+	inline AllocationFailureHandler allocationFailureHandler = [](const char *name, const AllocationCounts &counts)
+	{
+		std::cerr << name << " allocated " << counts.allocations << " times (" << counts.bytes << " bytes)\n";
+		std::abort();
+	};
+
+	/// @brief Marks a region that must not touch the heap, checked when it ends. Without LIB_TRACK_ALLOCATIONS it always passes.
+	struct NoAllocationScope final
+	{
+	private:
+		const char *name; // must outlive the scope, string literals are the intended use
+		AllocationScope scope;
+
+	public:
+		explicit NoAllocationScope(const char *name) noexcept : name(name), scope(AllocationScope()) {}
+
+		NoAllocationScope(const NoAllocationScope &) = delete;
+		NoAllocationScope &operator=(const NoAllocationScope &) = delete;
+
+		~NoAllocationScope()
+		{
+			AllocationCounts counts = scope.GetCounts();
+
+			if (counts.allocations > 0)
+			{
+				allocationFailureHandler(name, counts);
+			}
+		}
+	};
+}
+
+#ifdef LIB_TRACK_ALLOCATIONS
+// Every replaceable form is spelled out, even the ones the standard has forward to these two, since sanitizers replace them separately.
+void *operator new(usize size)
+{
+	Lib::Debug::AllocationCounts &counts = Lib::Debug::threadAllocationCounts;
+	++counts.allocations;
+	counts.bytes += size;
+
+	if (void *ptr = std::malloc(size != 0 ? size : 1))
+	{
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void *operator new(usize size, std::align_val_t alignment)
+{
+	Lib::Debug::AllocationCounts &counts = Lib::Debug::threadAllocationCounts;
+	usize align = static_cast<usize>(alignment);
+	++counts.allocations;
+	counts.bytes += size;
+
+#ifdef _MSC_VER
+	void *ptr = _aligned_malloc(size != 0 ? size : 1, align);
+#else
+	void *ptr = std::aligned_alloc(align, (std::max(size, static_cast<usize>(1)) + align - 1) / align * align); // has to be a multiple
+#endif
+
+	if (ptr != nullptr)
+	{
+		return ptr;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+	if (ptr != nullptr)
+	{
+		++Lib::Debug::threadAllocationCounts.deallocations;
+		std::free(ptr);
+	}
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+	if (ptr != nullptr)
+	{
+		++Lib::Debug::threadAllocationCounts.deallocations;
+#ifdef _MSC_VER
+		_aligned_free(ptr);
+#else
+		std::free(ptr);
+#endif
+	}
+}
+
+void *operator new[](usize size)
+{
+	return operator new(size);
+}
+
+void *operator new[](usize size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete(void *ptr, usize) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void *ptr, usize) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete(void *ptr, usize, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete[](void *ptr, usize, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void *operator new(usize size, const std::nothrow_t &) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (const std::bad_alloc &)
+	{
+		return nullptr;
+	}
+}
+
+void *operator new[](usize size, const std::nothrow_t &) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void *operator new(usize size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	try
+	{
+		return operator new(size, alignment);
+	}
+	catch (const std::bad_alloc &)
+	{
+		return nullptr;
+	}
+}
+
+void *operator new[](usize size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	return operator new(size, alignment, std::nothrow);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete[](void *ptr, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	operator delete(ptr, alignment);
 }
+#endif
 
 #endif // DEBUG_DEFINED
@@ -1,6 +1,11 @@
 ﻿#include <iostream>
 #include <vector>
 #include <span>
+#include <string_view>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
 
 #include "SDL.h"
 #include "SDL_image.h"
@@ -9,8 +14,9 @@
 #include "Memory.hpp"
 #include "Collections.hpp"
 #include "IO.hpp"
-#include "Debug.hpp"
+#include "Debug.hpp" // build with LIB_TRACK_ALLOCATIONS defined to count heap use per frame
 #include "Time.hpp"
+#include "Profiling.hpp"
 #include "SdlLib.hpp"
 #include "Stacker.hpp"
 
@@ -18,12 +24,26 @@ using namespace Lib;
 using namespace Lib::Sdl;
 using namespace Lib::Sdl::Text;
 using namespace Lib::Memory;
+using namespace Lib::Collections;
 using namespace Lib::Time;
 using namespace Lib::IO;
+using namespace Lib::Profiling;
+using namespace Lib::Debug;
 
 using namespace Stacker;
 
 // Go to https://lazyfoo.net/tutorials/SDL/ and https://www.studyplan.dev/ for some SDL2 tutorials!
+// What the board thread hands to the render thread each time something changed
+struct BoardFrame final
+{
+public:
+	BoardSnapshot board;
+	usize handledEvents; // how many forwarded events the board had seen when this was taken
+	DeltaTime updateTime; // spent in Board::Update() since the board thread started, so the time of frames the renderer skips still adds up
+	ProfileClock::time_point updateStart; // the last batch of ticks before this was taken, for the trace
+	ProfileClock::time_point updateEnd;
+};
+
 int main(int argc, char *argv[]) // main is now a macro!
 {
 	using enum Stacker::TetrominoType;
@@ -31,8 +51,6 @@ int main(int argc, char *argv[]) // main is now a macro!
 	// 125% scale on device...
 	constexpr int width = 1920 * 4 / 5;
 	constexpr int height = 1080 * 4 / 5;
-	constexpr int boardWidth = 10;
-	constexpr int boardHeight = 20;
 
 	std::atexit([]() -> void
 	{
@@ -97,73 +115,403 @@ int main(int argc, char *argv[]) // main is now a macro!
 		int2 { width / 2 + 32 * 6, height - 32 * 19 });
 
 	renderer.SetRenderDrawColor(0, 0, 0, 255);
-	StdTimer timer = StdTimer();
-	Board board = Board();
+	Board board = Board(); // owned by the board thread once it starts
+	Font pausedFont = Font(GetFontPath("hun2.ttf"), 36);
+	TextRenderGuide pausedRenderGuide = TextRenderGuide(int2 { width / 2, height / 2 - 18 });
+	constexpr int pausedWaitTimeout = 250; // in milliseconds, only bounds how long a quit request can go unnoticed
+	constexpr int idleWaitTimeout = 250; // the same after a frame that had nothing new to show, boardFrameEvent wakes us for the next one
+	constexpr int boardTraceThreadId = 2; // the board thread's track in the profiler's trace
+	constexpr DeltaTime tickTime = Board::tickTime; // the board's fixed step, one tick of its timelines
+	constexpr std::chrono::milliseconds pausedTickTime = std::chrono::milliseconds(16); // keeps a paused board from waking a core a thousand times a second
+	constexpr std::chrono::milliseconds maxCatchUpTime = std::chrono::milliseconds(250); // ticks further behind than this are dropped rather than run in a burst
+	SpscQueue<SDL_Event, 256> boardEvents = SpscQueue<SDL_Event, 256>(); // render thread to board thread
+	TripleBuffer<BoardFrame> boardFrames = TripleBuffer<BoardFrame>(); // board thread to render thread
+	const Uint32 boardFrameEvent = RegisterEvents(1); // pushed by the board thread after it publishes a frame
+	std::atomic<bool> boardFrameEventPending = false; // at most one in SDL's queue at a time, however fast frames come
+	DeltaTime recordedUpdateTime = 0.0; // how much of the board thread's update time the profiler has been told about
+	usize sentEvents = 0;
 	bool looping = true;
+	bool redraw = true; // forced redraws for changes the board doesn't know about, like the window being exposed
+	bool rendered = true;
+	usize renderedVersion = 0;
+	FrameProfiler profiler = FrameProfiler();
+	Font profilerFont = Font(GetFontPath("hun2.ttf"), 16);
+	bool showProfiler = false;
+	AllocationScope frameAllocations = AllocationScope();
+	AllocationCounts lastFrameAllocations = { 0, 0, 0 };
+	usize frameNumber = 0;
 
-	while (looping)
+	auto handleEvent = [&](const SDL_Event &event) -> void
 	{
-		DeltaTime deltaTime = timer.GetDeltaTime();
+		if (event.type == SDL_EventType::SDL_QUIT || Held(event, SDL_KeyCode::SDLK_ESCAPE))
+		{
+			looping = false;
+		}
+		else if (event.type == boardFrameEvent)
+		{
+			boardFrameEventPending.store(false, std::memory_order_relaxed); // the frame itself comes through boardFrames
+		}
+		else if (IsWindowEvent(event, SDL_WINDOWEVENT_EXPOSED) || IsWindowEvent(event, SDL_WINDOWEVENT_SIZE_CHANGED))
+		{
+			redraw = true;
+		}
+		else if (Held(event, SDL_KeyCode::SDLK_F3) && event.key.repeat == 0)
+		{
+			showProfiler = !showProfiler;
+			redraw = true;
+		}
+		else if (Held(event, SDL_KeyCode::SDLK_F4) && event.key.repeat == 0)
+		{
+			if (profiler.IsTracing())
+			{
+				profiler.StopTrace();
+				string tracePath = string(basePath) + "trace.json";
 
-		while (PollEvent(event) != 0)
+				if (!profiler.WriteTrace(tracePath))
+				{
+					std::cerr << "Could not write " << tracePath << '\n';
+				}
+			}
+			else
+			{
+				profiler.StartTrace();
+			}
+		}
+
+		// Only what the board reacts to, so mouse movement can't fill the queue. It's drained every tick, so a full queue doesn't last.
+		if (event.type == SDL_EventType::SDL_KEYDOWN || event.type == SDL_EventType::SDL_KEYUP || event.type == SDL_EventType::SDL_WINDOWEVENT)
 		{
-			if (event.type == SDL_EventType::SDL_QUIT || Held(event, SDL_KeyCode::SDLK_ESCAPE))
+			while (!boardEvents.TryPush(event))
 			{
-				looping = false;
+				std::this_thread::yield();
 			}
 
-			board.UpdateEvent(event);
+			++sentEvents;
+		}
+	};
+
+	// Rolling frame time graph plus the p50/p99 and the phase breakdown of the last frame, toggled with F3
+	auto renderProfiler = [&]() -> void
+	{
+		constexpr int graphHeight = 100;
+		constexpr DeltaTime graphMaxTime = 1.0 / 30.0;
+		constexpr int lineHeight = 20;
+		const int2 graphOrigin = { 16, 16 };
+		usize frameCount = profiler.GetFrameCount();
+		char text[64];
+
+		auto toGraphY = [&](DeltaTime time) -> int
+		{
+			return graphOrigin.y + graphHeight - static_cast<int>(std::min(time / graphMaxTime, 1.0) * graphHeight);
+		};
+
+		renderer.SetRenderDrawBlendMode(SDL_BLENDMODE_BLEND);
+		renderer.SetRenderDrawColor(0, 0, 0, 192);
+		renderer.RenderFillRect(Rect(graphOrigin, static_cast<int>(FrameProfiler::historyLength), graphHeight));
+		renderer.SetRenderDrawColor(96, 96, 96, 255);
+		renderer.RenderDrawLine(int2 { graphOrigin.x, toGraphY(1.0 / 60.0) }, 
+			int2 { graphOrigin.x + static_cast<int>(FrameProfiler::historyLength), toGraphY(1.0 / 60.0) });
+		renderer.SetRenderDrawColor(82, 207, 173, 255);
+
+		for (usize i = 1; i < frameCount; ++i)
+		{
+			renderer.RenderDrawLine(int2 { graphOrigin.x + static_cast<int>(i) - 1, toGraphY(profiler.GetFrameTime(i - 1)) },
+				int2 { graphOrigin.x + static_cast<int>(i), toGraphY(profiler.GetFrameTime(i)) });
+		}
+
+		renderer.SetRenderDrawColor(0, 0, 0, 255);
+		renderer.SetRenderDrawBlendMode(SDL_BLENDMODE_NONE);
+		int y = graphOrigin.y + graphHeight + 4;
+
+		std::snprintf(text, sizeof(text), "FRAME P50 %.2f MS  P99 %.2f MS%s", profiler.GetPercentile(0.5) * 1000.0, 
+			profiler.GetPercentile(0.99) * 1000.0, profiler.IsTracing() ? "  TRACING" : "");
+		TextRenderGuide(int2 { graphOrigin.x, y }).RenderTopLeftAligned(renderer, profilerFont, text, SDL_Color { 255, 255, 255, 255 });
+
+		for (usize i = 0; i < profiler.GetPhaseCount(); ++i)
+		{
+			const PhaseTime &phase = profiler.GetPhases()[i];
+			y += lineHeight;
+			std::snprintf(text, sizeof(text), "%s %.3f MS", phase.name, phase.time * 1000.0);
+			TextRenderGuide(int2 { graphOrigin.x, y }).RenderTopLeftAligned(renderer, profilerFont, text, SDL_Color { 255, 255, 255, 255 });
 		}
 
-		board.Update(deltaTime);
-		renderer.RenderClear();
+		if (allocationTrackingEnabled)
+		{
+			y += lineHeight;
+			std::snprintf(text, sizeof(text), "ALLOCS %zu (%zu B)", lastFrameAllocations.allocations, lastFrameAllocations.bytes);
+			TextRenderGuide(int2 { graphOrigin.x, y }).RenderTopLeftAligned(renderer, profilerFont, text, SDL_Color { 255, 255, 255, 255 });
+		}
+	};
 
-		for (int i = 0; i < boardWidth; ++i)
+	auto render = [&](const BoardSnapshot &snapshot) -> void
+	{
 		{
-			for (int j = 0; j < boardHeight; ++j)
+			ScopedTimer scope = profiler.Scope("Board");
+			renderer.RenderClear();
+
+			for (int i = 0; i < Board::width; ++i)
 			{
-				//tileMap.RenderTo(renderer, gridTexture, nullptr, ReversedY(int2{i, j}));
-				tileMap.RenderTo(renderer, gridTexture, nullptr, int2 { i, -j });
+				for (int j = 0; j < Board::visibleHeight; ++j)
+				{
+					//tileMap.RenderTo(renderer, gridTexture, nullptr, ReversedY(int2{i, j}));
+					tileMap.RenderTo(renderer, gridTexture, nullptr, int2 { i, -j });
+				}
 			}
+
+			tileMap.RenderTo(renderer, snapshot, tetrominoTextures, ghostTextures, spawnTexture, clearedTexture, separatorTexture);
 		}
 
-		tileMap.RenderTo(renderer, board, tetrominoTextures, ghostTextures, spawnTexture, clearedTexture, separatorTexture);
-		const LineClearData &lineClearData = board.GetLineClearData();
-		string spinText = lineClearData.GetSpinText();
-		string lineClearText = lineClearData.GetLineClearText();
-		string allClearText = lineClearData.GetAllClearText();
-		string b2bText = lineClearData.GetB2bText();
-		string comboText = lineClearData.GetComboText();
-		Uint8 alpha = board.GetTextAlpha();
-		usize score = board.GetScore();
+		{
+			ScopedTimer scope = profiler.Scope("Text");
+			const LineClearData &lineClearData = snapshot.lineClearData;
+			// null terminated views into the scratch arena, good until the frame after next
+			std::string_view spinText = lineClearData.GetSpinText();
+			std::string_view lineClearText = lineClearData.GetLineClearText();
+			std::string_view allClearText = lineClearData.GetAllClearText();
+			std::string_view b2bText = lineClearData.GetB2bText();
+			std::string_view comboText = lineClearData.GetComboText();
+			Uint8 alpha = snapshot.textAlpha;
+			usize score = snapshot.score;
 		
-		if (!spinText.empty())
+			if (!spinText.empty())
+			{
+				spinRenderGuide.RenderTopRightAligned(renderer, spinFont, spinText.data(), Color(lineClearData.GetColor(), alpha));
+			}
+
+			if (!lineClearText.empty())
+			{
+				lineClearRenderGuide.RenderTopRightAligned(renderer, lineClearFont, lineClearText.data(), SDL_Color { 255, 255, 255, alpha });
+			}
+
+			if (!b2bText.empty())
+			{
+				b2bRenderGuide.RenderTopRightAligned(renderer, b2bFont, b2bText.data(), Color(lineClearData.GetB2bColor(), lineClearData.longB2bStreakBroken ? alpha : 255));
+			}
+
+			if (!comboText.empty())
+			{
+				comboRenderGuide.RenderTopRightAligned(renderer, comboFont, comboText.data(), SDL_Color { 255, 255, 255, alpha });
+			}
+
+			if (!allClearText.empty())
+			{
+				allClearRenderGuide.RenderTopRightAligned(renderer, allClearFont, allClearText.data(), SDL_Color { 206, 197, 82, alpha });
+			}
+
+			scoreRenderGuide.RenderTopCenterAligned(renderer, scoreFont, Allocation::ScratchText({ score }).data(), SDL_Color { 255, 255, 255, 255 });
+
+			if (snapshot.paused)
+			{
+				pausedRenderGuide.RenderTopCenterAligned(renderer, pausedFont, "PAUSED", SDL_Color { 255, 255, 255, 255 });
+			}
+		}
+
+		if (showProfiler)
 		{
-			spinRenderGuide.RenderTopRightAligned(renderer, spinFont, spinText, Color(lineClearData.GetColor(), alpha));
+			ScopedTimer scope = profiler.Scope("Overlay");
+			renderProfiler();
 		}
 
-		if (!lineClearText.empty())
+		ScopedTimer presentScope = profiler.Scope("Present");
+		renderer.RenderPresent();
+	};
+
+	// Returns whether a frame was actually drawn
+	auto renderIfChanged = [&]() -> bool
+	{
+		const BoardSnapshot &snapshot = boardFrames.GetFront().board;
+
+		if (redraw || showProfiler || snapshot.stateVersion != renderedVersion)
+		{
+			render(snapshot);
+			renderedVersion = snapshot.stateVersion;
+			redraw = false;
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	};
+
+	// Everything below runs on the board thread: events from the queue, then one fixed step, then a snapshot if anything changed.
+	// Window focus is handled here too, since pausing is the board's business.
+	auto runBoard = [&](std::stop_token stopToken) -> void
+	{
+		using Clock = std::chrono::steady_clock;
+		const Clock::duration tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<DeltaTime>(tickTime));
+		Clock::time_point nextTick = Clock::now();
+		usize handledEvents = 0;
+		usize publishedEvents = 0;
+		usize publishedVersion = board.GetStateVersion();
+		bool autoPaused = false; // paused by losing focus or minimizing rather than by the pause key
+		AllocationScope tickAllocations = AllocationScope();
+		usize tickNumber = 0;
+		DeltaTime updateTime = 0.0;
+		ProfileClock::time_point updateStart = ProfileClock::now();
+		ProfileClock::time_point updateEnd = updateStart;
+
+		auto handleBoardEvent = [&](const SDL_Event &event) -> void
+		{
+			if (IsWindowEvent(event, SDL_WINDOWEVENT_FOCUS_LOST) || IsWindowEvent(event, SDL_WINDOWEVENT_MINIMIZED))
+			{
+				if (!board.IsPaused())
+				{
+					board.SetPaused(true);
+					autoPaused = true;
+				}
+			}
+			else if (IsWindowEvent(event, SDL_WINDOWEVENT_FOCUS_GAINED) || IsWindowEvent(event, SDL_WINDOWEVENT_RESTORED))
+			{
+				if (autoPaused)
+				{
+					board.SetPaused(false);
+				}
+			}
+
+			board.UpdateEvent(event);
+
+			if (!board.IsPaused())
+			{
+				autoPaused = false;
+			}
+
+			++handledEvents;
+		};
+
+		while (!stopToken.stop_requested())
+		{
+			Allocation::NextScratchFrame();
+			boardEvents.Drain(handleBoardEvent);
+
+			if (board.IsPaused())
+			{
+				nextTick = Clock::now() + pausedTickTime; // the paused time must not be caught up on afterwards
+			}
+			else
+			{
+				Clock::time_point now = Clock::now();
+
+				if (now - nextTick > maxCatchUpTime)
+				{
+					nextTick = now;
+				}
+
+				if (nextTick <= now)
+				{
+					updateStart = ProfileClock::now();
+
+					for (; nextTick <= now; nextTick += tickDuration)
+					{
+						board.Update(tickTime);
+					}
+
+					updateEnd = ProfileClock::now();
+					updateTime += std::chrono::duration_cast<std::chrono::duration<DeltaTime>>(updateEnd - updateStart).count();
+				}
+			}
+
+			if (board.GetStateVersion() != publishedVersion || handledEvents != publishedEvents)
+			{
+				BoardFrame &frame = boardFrames.GetBack();
+				frame.board.Capture(board);
+				frame.handledEvents = handledEvents;
+				frame.updateTime = updateTime;
+				frame.updateStart = updateStart;
+				frame.updateEnd = updateEnd;
+				boardFrames.Publish();
+				publishedVersion = board.GetStateVersion();
+				publishedEvents = handledEvents;
+
+				if (!boardFrameEventPending.exchange(true, std::memory_order_relaxed))
+				{
+					SDL_Event wake = SDL_Event();
+					wake.type = boardFrameEvent;
+					PushEvent(wake);
+				}
+			}
+
+			AllocationCounts allocations = tickAllocations.GetCounts();
+			tickAllocations.Restart();
+
+			if (allocationTrackingEnabled && allocations.allocations > 0)
+			{
+				std::cerr << "Tick " << tickNumber << ": " << allocations.allocations << " allocations (" << allocations.bytes << " bytes)\n";
+			}
+
+			++tickNumber;
+			std::this_thread::sleep_until(nextTick);
+		}
+	};
+
+	BoardFrame &firstFrame = boardFrames.GetBack();
+	firstFrame.board.Capture(board);
+	firstFrame.handledEvents = 0;
+	firstFrame.updateTime = 0.0;
+	firstFrame.updateStart = ProfileClock::now();
+	firstFrame.updateEnd = firstFrame.updateStart;
+	boardFrames.Publish();
+	boardFrames.Update();
+	std::jthread boardThread = std::jthread(runBoard); // asked to stop and joined when main returns
+
+	while (looping)
+	{
+		profiler.BeginFrame();
+		Allocation::NextScratchFrame();
+		boardFrames.Update();
+		const BoardFrame &latestFrame = boardFrames.GetFront();
+		// While the board hasn't caught up with what we sent it, the snapshot's paused flag may be about to change
+		bool paused = latestFrame.board.paused && latestFrame.handledEvents == sentEvents;
+		bool hasEvent = false;
+
+		// Nobody is playing, or nothing changed last frame (so RenderPresent didn't throttle us): 
+		// sleep inside SDL until something happens instead of spinning on PollEvent
+		int waitTimeout = paused ? pausedWaitTimeout : (rendered ? 0 : idleWaitTimeout);
+
+		if (waitTimeout > 0)
 		{
-			lineClearRenderGuide.RenderTopRightAligned(renderer, lineClearFont, lineClearText, SDL_Color { 255, 255, 255, alpha });
+			ScopedTimer scope = profiler.Scope("Idle");
+			hasEvent = WaitEventTimeout(event, waitTimeout) != 0;
 		}
 
-		if (!b2bText.empty())
 		{
-			b2bRenderGuide.RenderTopRightAligned(renderer, b2bFont, b2bText, Color(lineClearData.GetB2bColor(), lineClearData.longB2bStreakBroken ? alpha : 255));
+			ScopedTimer scope = profiler.Scope("Events");
+
+			if (hasEvent)
+			{
+				handleEvent(event);
+			}
+
+			while (PollEvent(event) != 0)
+			{
+				handleEvent(event);
+			}
 		}
 
-		if (!comboText.empty())
+		boardFrames.Update();
+		const BoardFrame &renderedFrame = boardFrames.GetFront();
+
+		// The board ticks on its own thread, its time shows up in the frame that first sees the result
+		if (renderedFrame.updateTime != recordedUpdateTime)
 		{
-			comboRenderGuide.RenderTopRightAligned(renderer, comboFont, comboText, SDL_Color { 255, 255, 255, alpha });
+			profiler.Record("Update", renderedFrame.updateTime - recordedUpdateTime, renderedFrame.updateStart, renderedFrame.updateEnd,
+				boardTraceThreadId);
+			recordedUpdateTime = renderedFrame.updateTime;
 		}
 
-		if (!allClearText.empty())
+		rendered = renderIfChanged();
+		profiler.EndFrame();
+		lastFrameAllocations = frameAllocations.GetCounts();
+		frameAllocations.Restart();
+
+		// The steady state should print nothing here
+		if (allocationTrackingEnabled && lastFrameAllocations.allocations > 0)
 		{
-			allClearRenderGuide.RenderTopRightAligned(renderer, allClearFont, allClearText, SDL_Color { 206, 197, 82, alpha });
+			std::cerr << "Frame " << frameNumber << ": " << lastFrameAllocations.allocations << " allocations (" <<
+				lastFrameAllocations.bytes << " bytes)\n";
 		}
 
-		scoreRenderGuide.RenderTopCenterAligned(renderer, scoreFont, std::to_string(score), SDL_Color { 255, 255, 255, 255 });
-		renderer.RenderPresent();
+		++frameNumber;
 	}
 
 	return 0;
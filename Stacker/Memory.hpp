@@ -6,10 +6,21 @@
 #include <type_traits>
 #include <memory>
 #include <exception>
+#include <atomic>
 #include <utility>
+#include <new>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <concepts>
+#include <charconv>
+#include <span>
+#include <string_view>
+#include <initializer_list>
 
 #include "Lib.hpp"
 
+// Compiler specific and can't outlive the calling function, Allocation::ScratchArray is the portable way to get temporary storage.
 #define STACK_ALLOC(T, LENGTH) static_cast<T *>(alloca((LENGTH) * ::Lib::Memory::SizeOf<T>()))
 
 namespace Lib::Memory // Temporary const T & parameters are valid until the end of their containing methods
@@ -106,157 +117,414 @@ namespace Lib::Memory // Temporary const T & parameters are valid until the end
 		std::copy(src, src + sizeof(T), PtrCast<byte>(std::addressof(destination)));
 	}
 
-	template <typename T, auto...>
-	class SharedPtr;
+	// Atomic counts cost a locked instruction per copy, only pay for it when the object is shared between threads.
+	enum struct SharingPolicy : bool
+	{
+		SingleThreaded,
+		Atomic
+	};
 
-	template <typename T>
-	class SharedPtr<T> final
+	namespace Helpers // not anonymous, SharedPtr members use these types
+	{
+		template <const SharingPolicy Policy>
+		struct RefCounter;
+
+		template <>
+		struct RefCounter<SharingPolicy::SingleThreaded> final
+		{
+		private:
+			int count;
+
+		public:
+			explicit RefCounter(int count) noexcept : count(count) {}
+
+			int Get() const noexcept
+			{
+				return count;
+			}
+
+			void Increment() noexcept
+			{
+				++count;
+			}
+
+			// Returns whether this was the last one
+			bool Decrement() noexcept
+			{
+				return --count == 0;
+			}
+
+			bool IncrementIfNotZero() noexcept
+			{
+				return count != 0 ? (++count, true) : false;
+			}
+		};
+
+		template <>
+		struct RefCounter<SharingPolicy::Atomic> final
+		{
+		private:
+			std::atomic<int> count;
+
+		public:
+			explicit RefCounter(int count) noexcept : count(count) {}
+
+			int Get() const noexcept
+			{
+				return count.load(std::memory_order_relaxed);
+			}
+
+			void Increment() noexcept
+			{
+				count.fetch_add(1, std::memory_order_relaxed); // whoever copies already holds a reference, nothing to synchronize with
+			}
+
+			// acq_rel, so the thread that destroys the object sees every other thread's last writes to it
+			bool Decrement() noexcept
+			{
+				return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+			}
+
+			bool IncrementIfNotZero() noexcept
+			{
+				int expected = count.load(std::memory_order_relaxed);
+
+				while (expected != 0)
+				{
+					if (count.compare_exchange_weak(expected, expected + 1, std::memory_order_acquire, std::memory_order_relaxed))
+					{
+						return true;
+					}
+				}
+
+				return false;
+			}
+		};
+
+		// The object is destroyed when the use count reaches 0, the block itself when the weak count does, the strong references
+		// together holding one weak reference.
+		template <const SharingPolicy Policy>
+		struct ControlBlock
+		{
+		public:
+			RefCounter<Policy> useCount;
+			RefCounter<Policy> weakCount;
+
+			ControlBlock() noexcept : useCount(1), weakCount(1) {}
+
+			ControlBlock(const ControlBlock &) = delete;
+			ControlBlock &operator=(const ControlBlock &) = delete;
+
+			virtual void DestroyObject() noexcept = 0;
+			virtual void Free() noexcept = 0;
+
+			void ReleaseStrong() noexcept
+			{
+				if (useCount.Decrement())
+				{
+					DestroyObject();
+					ReleaseWeak();
+				}
+			}
+
+			void ReleaseWeak() noexcept
+			{
+				if (weakCount.Decrement())
+				{
+					Free();
+				}
+			}
+
+		protected:
+			~ControlBlock() = default;
+		};
+
+		// What MakeShared creates, the object lives right after the counts so both come from one allocation.
+		template <typename T, const SharingPolicy Policy>
+		struct InPlaceControlBlock final : ControlBlock<Policy>
+		{
+		private:
+			alignas(T) byte storage[sizeof(T)];
+
+		public:
+			template <typename ...TParams>
+			explicit InPlaceControlBlock(TParams &&...params)
+			{
+				new (storage) T(std::forward<TParams>(params)...);
+			}
+
+			T *GetObject() noexcept
+			{
+				return std::launder(reinterpret_cast<T *>(storage));
+			}
+
+			void DestroyObject() noexcept override
+			{
+				std::destroy_at(GetObject());
+			}
+
+			void Free() noexcept override
+			{
+				delete this;
+			}
+		};
+
+		// For adopting an already allocated object.
+		template <typename T, const SharingPolicy Policy, typename TDeleter>
+		struct PointerControlBlock final : ControlBlock<Policy>
+		{
+		private:
+			T *ptr;
+			TDeleter deleter;
+
+		public:
+			PointerControlBlock(T *ptr, TDeleter deleter) noexcept : ptr(ptr), deleter(std::move(deleter)) {}
+
+			void DestroyObject() noexcept override
+			{
+				deleter(ptr);
+			}
+
+			void Free() noexcept override
+			{
+				delete this;
+			}
+		};
+	}
+
+	template <typename T, const SharingPolicy Policy = SharingPolicy::SingleThreaded>
+	class WeakPtr;
+
+	/// @brief Reference counted ownership. MakeShared puts the object and its counts in one allocation,
+	/// Policy picks whether copies and releases may race between threads (the object itself is as thread-safe as it is).
+	template <typename T, const SharingPolicy Policy = SharingPolicy::SingleThreaded>
+	class SharedPtr final
 	{
 	private:
-		std::remove_const_t<T> *ptr;
-		mutable int *useCount;
+		template <typename, const SharingPolicy>
+		friend class SharedPtr;
 
-		struct InPlaceTag {};
-		
-		template <typename ...TParams>
-		constexpr SharedPtr(InPlaceTag, TParams &&...params) noexcept(noexcept(T(std::forward<TParams>(params)...))) :
-			ptr(new T(std::forward<TParams>(params)...)), useCount(new int(1)) {}
+		friend class WeakPtr<T, Policy>;
+
+		struct AdoptTag {};
+
+		T *ptr;
+		Helpers::ControlBlock<Policy> *block;
+
+		// takes over a reference the caller already counted
+		SharedPtr(AdoptTag, T *ptr, Helpers::ControlBlock<Policy> *block) noexcept : ptr(ptr), block(block) {}
 
 	public:
 		using value_type = T;
 
-		constexpr SharedPtr() noexcept = default;
+		constexpr SharedPtr() noexcept : ptr(nullptr), block(nullptr) {}
 		constexpr SharedPtr(std::nullptr_t) noexcept : SharedPtr() {}
-		constexpr SharedPtr(T *ptr) noexcept : ptr(ptr), useCount(ptr != nullptr ? new int(1) : nullptr) {}
-		constexpr SharedPtr(T &&value) noexcept(noexcept(T(std::move(value)))) : ptr(new T(std::move(value))), useCount(new int(1)) {}
 
-		constexpr SharedPtr(const SharedPtr &other) noexcept : ptr(other.ptr), useCount(other.useCount)
+		// Takes ownership of ptr, which costs a second allocation for the counts, prefer MakeShared.
+		explicit SharedPtr(T *ptr) : SharedPtr(ptr, std::default_delete<T>()) {}
+
+		template <typename TDeleter> requires std::invocable<TDeleter &, T *>
+		SharedPtr(T *ptr, TDeleter deleter) : ptr(ptr), block(nullptr)
 		{
-			++(*useCount);
+			if (ptr != nullptr)
+			{
+				try
+				{
+					block = new Helpers::PointerControlBlock<T, Policy, TDeleter>(ptr, deleter);
+				}
+				catch (...)
+				{
+					deleter(ptr);
+					throw;
+				}
+			}
 		}
 
-		constexpr SharedPtr(SharedPtr &&other) noexcept : ptr(std::exchange(other.ptr, nullptr)), 
-			useCount(std::exchange(other.useCount, nullptr)) {}
+		SharedPtr(T &&value) : SharedPtr(New(std::move(value))) {}
 
-		constexpr int GetUseCount() const noexcept
+		SharedPtr(const SharedPtr &other) noexcept : ptr(other.ptr), block(other.block)
 		{
-			return useCount != nullptr ? (*useCount) : 0;
+			if (block != nullptr)
+			{
+				block->useCount.Increment();
+			}
 		}
 
-		constexpr const T *operator->() const noexcept
+		SharedPtr(SharedPtr &&other) noexcept : ptr(std::exchange(other.ptr, nullptr)), block(std::exchange(other.block, nullptr)) {}
+
+		// e.g. from a derived class to its base
+		template <typename TOther> requires std::is_convertible_v<TOther *, T *>
+		SharedPtr(const SharedPtr<TOther, Policy> &other) noexcept : ptr(other.ptr), block(other.block)
 		{
-			return ptr;
+			if (block != nullptr)
+			{
+				block->useCount.Increment();
+			}
 		}
 
-		constexpr T *operator->() noexcept
+		template <typename TOther> requires std::is_convertible_v<TOther *, T *>
+		SharedPtr(SharedPtr<TOther, Policy> &&other) noexcept : ptr(std::exchange(other.ptr, nullptr)), 
+			block(std::exchange(other.block, nullptr)) {}
+
+		SharedPtr &operator=(const SharedPtr &other) noexcept
+		{
+			SharedPtr(other).Swap(*this);
+			return *this;
+		}
+
+		SharedPtr &operator=(SharedPtr &&other) noexcept
+		{
+			SharedPtr(std::move(other)).Swap(*this);
+			return *this;
+		}
+
+		void Swap(SharedPtr &other) noexcept
+		{
+			std::swap(ptr, other.ptr);
+			std::swap(block, other.block);
+		}
+
+		void Reset() noexcept
+		{
+			SharedPtr().Swap(*this);
+		}
+
+		int GetUseCount() const noexcept
+		{
+			return block != nullptr ? block->useCount.Get() : 0;
+		}
+
+		T *Get() const noexcept
 		{
 			return ptr;
 		}
 
-		constexpr const T &operator*() const noexcept
+		T *operator->() const noexcept
 		{
-			return *operator->();
+			return ptr;
 		}
 
-		constexpr T &operator*() noexcept
+		T &operator*() const noexcept
 		{
-			return *operator->();
+			return *ptr;
 		}
 
-		constexpr explicit operator bool() const noexcept
+		explicit operator bool() const noexcept
 		{
 			return ptr != nullptr;
 		}
 
+		template <typename TOther>
+		friend bool operator==(const SharedPtr &lhs, const SharedPtr<TOther, Policy> &rhs) noexcept
+		{
+			return lhs.Get() == rhs.Get();
+		}
+
+		friend bool operator==(const SharedPtr &lhs, std::nullptr_t) noexcept
+		{
+			return lhs.ptr == nullptr;
+		}
+
 		template <typename ...TParams>
-		static constexpr SharedPtr New(TParams &&...params) noexcept(noexcept(T(std::forward<TParams>(params)...)))
+		static SharedPtr New(TParams &&...params)
 		{
-			return SharedPtr(InPlaceTag{}, std::forward<TParams>(params)...);
+			Helpers::InPlaceControlBlock<std::remove_const_t<T>, Policy> *block = 
+				new Helpers::InPlaceControlBlock<std::remove_const_t<T>, Policy>(std::forward<TParams>(params)...);
+			return SharedPtr(AdoptTag {}, block->GetObject(), block);
 		}
 
 		~SharedPtr()
 		{
-			if (useCount != nullptr && (--(*useCount)) <= 0)
+			if (block != nullptr)
 			{
-				int &count = *useCount;
-				--count;
-
-				if (count <= 0)
-				{
-					delete useCount;
-					delete ptr;
-				}
+				block->ReleaseStrong();
 			}
 		}
 	};
 
-	template <typename T, auto Deleter>
-	class SharedPtr<T, Deleter> final
+	/// @brief Observes a SharedPtr without keeping the object alive, Lock() to use it.
+	template <typename T, const SharingPolicy Policy>
+	class WeakPtr final
 	{
 	private:
 		T *ptr;
-		int *useCount;
+		Helpers::ControlBlock<Policy> *block;
 
 	public:
-		SharedPtr() noexcept = default;
+		constexpr WeakPtr() noexcept : ptr(nullptr), block(nullptr) {}
 
-		SharedPtr(T *ptr) noexcept : ptr(ptr), useCount(new int(1)) {}
-		SharedPtr(T *ptr, decltype(Deleter)) noexcept : SharedPtr(ptr) {}
+		WeakPtr(const SharedPtr<T, Policy> &shared) noexcept : ptr(shared.ptr), block(shared.block)
+		{
+			if (block != nullptr)
+			{
+				block->weakCount.Increment();
+			}
+		}
 
-		SharedPtr(const SharedPtr &other) noexcept : ptr(other.ptr), useCount(other.useCount)
+		WeakPtr(const WeakPtr &other) noexcept : ptr(other.ptr), block(other.block)
 		{
-			++(*useCount);
+			if (block != nullptr)
+			{
+				block->weakCount.Increment();
+			}
 		}
 
-		int GetUseCount() const noexcept
+		WeakPtr(WeakPtr &&other) noexcept : ptr(std::exchange(other.ptr, nullptr)), block(std::exchange(other.block, nullptr)) {}
+
+		WeakPtr &operator=(const WeakPtr &other) noexcept
 		{
-			return useCount != nullptr ? (*useCount) : 0;
+			WeakPtr(other).Swap(*this);
+			return *this;
 		}
 
-		constexpr const T *operator->() const noexcept
+		WeakPtr &operator=(WeakPtr &&other) noexcept
 		{
-			return ptr;
+			WeakPtr(std::move(other)).Swap(*this);
+			return *this;
 		}
 
-		constexpr T *operator->() noexcept
+		void Swap(WeakPtr &other) noexcept
 		{
-			return ptr;
+			std::swap(ptr, other.ptr);
+			std::swap(block, other.block);
 		}
 
-		constexpr const T &operator*() const noexcept
+		void Reset() noexcept
 		{
-			return *operator->();
+			WeakPtr().Swap(*this);
 		}
 
-		constexpr T &operator*() noexcept
+		int GetUseCount() const noexcept
 		{
-			return *operator->();
+			return block != nullptr ? block->useCount.Get() : 0;
 		}
 
-		~SharedPtr() noexcept(noexcept(Deleter(ptr)))
+		// Only a hint across threads, it can expire right after returning false.
+		bool IsExpired() const noexcept
 		{
-			if (useCount != nullptr)
-			{
-				int &count = useCount;
-				--count;
+			return GetUseCount() == 0;
+		}
 
-				if (count <= 0)
-				{
-					if (ptr != nullptr)
-					{
-						Deleter(ptr);
-					}
+		/// @return The object if it's still alive, a null SharedPtr otherwise
+		SharedPtr<T, Policy> Lock() const noexcept
+		{
+			return block != nullptr && block->useCount.IncrementIfNotZero() ? SharedPtr<T, Policy>(typename SharedPtr<T, Policy>::AdoptTag {}, ptr, block) :
+				SharedPtr<T, Policy>();
+		}
 
-					delete useCount;
-				}
+		~WeakPtr()
+		{
+			if (block != nullptr)
+			{
+				block->ReleaseWeak();
 			}
 		}
 	};
 
-	template <typename T, typename ...TParams>
-	constexpr SharedPtr<T> MakeShared(TParams &&...params)
+	template <typename T, const SharingPolicy Policy = SharingPolicy::SingleThreaded, typename ...TParams>
+	SharedPtr<T, Policy> MakeShared(TParams &&...params)
 	{
-		return SharedPtr<T>::New(std::forward<TParams>(params)...);
+		return SharedPtr<T, Policy>::New(std::forward<TParams>(params)...);
 	}
 
 	template <typename T>
@@ -486,6 +754,8 @@ namespace Lib::Memory::Allocation
 	struct Allocator
 	{
 	public:
+		using value_type = T;
+
 		constexpr Allocator() noexcept = default;
 
 		template <typename TOther>
@@ -525,15 +795,501 @@ namespace Lib::Memory::Allocation
 		std::remove_const_t<value_type> *ptr;
 
 	public:
-		constexpr AllocatorPtr(TAllocator &allocator, usize length) noexcept(noexcept(allocator.allocate(ptr, length))) :
-			ptr(allocator.allocate(ptr, length)) {}
+		constexpr AllocatorPtr(TAllocator &allocator, usize length) noexcept(noexcept(allocator.allocate(length))) :
+			ptr(allocator.allocate(length)) {}
+
+		constexpr std::remove_const_t<value_type> *Get() const noexcept
+		{
+			return ptr;
+		}
 
 		// TODO: Forwarding TAllocator to automatically pick the correct one?
-		constexpr void Deallocate(TAllocator &allocator, usize length) const noexcept(noexcept(allocator.deallocate(ptr, length)))
+		constexpr void Deallocate(TAllocator &allocator, usize length) noexcept(noexcept(allocator.deallocate(ptr, length)))
 		{
-			allocator.allocate(ptr, length);
+			allocator.deallocate(ptr, length);
+			ptr = nullptr;
 		}
 	};
+
+	constexpr usize AlignUp(usize value, usize alignment) noexcept
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	/// @brief Hands out memory by bumping an offset through a chain of blocks, and frees nothing until Reset(), which rewinds to
+	/// the first block in O(1) and keeps every block for reuse. Not thread-safe, so one per thread (or per search).
+	class MonotonicArena final
+	{
+	private:
+		struct Block final
+		{
+		public:
+			Block *next;
+			usize capacity;
+
+			byte *GetData() noexcept
+			{
+				return PtrCast<byte>(this) + AlignUp(sizeof(Block), alignof(std::max_align_t));
+			}
+		};
+
+		Block *head;
+		Block *current;
+		usize offset;
+		usize nextBlockSize;
+
+		static Block *NewBlock(usize capacity)
+		{
+			void *memory = ::operator new(AlignUp(sizeof(Block), alignof(std::max_align_t)) + capacity);
+			return new (memory) Block { nullptr, capacity };
+		}
+
+	public:
+		static constexpr usize defaultBlockSize = 64 * 1024;
+
+		explicit MonotonicArena(usize initialBlockSize = defaultBlockSize) noexcept : head(nullptr), current(nullptr), offset(0),
+			nextBlockSize(std::max(initialBlockSize, static_cast<usize>(64))) {}
+
+		MonotonicArena(const MonotonicArena &) = delete;
+		MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+		[[nodiscard]]
+		void *Allocate(usize size, usize alignment = alignof(std::max_align_t))
+		{
+			while (current != nullptr)
+			{
+				usize address = reinterpret_cast<usize>(current->GetData()) + offset;
+				usize start = AlignUp(address, alignment) - reinterpret_cast<usize>(current->GetData());
+
+				if (start + size <= current->capacity)
+				{
+					offset = start + size;
+					return current->GetData() + start;
+				}
+
+				if (current->next == nullptr)
+				{
+					break;
+				}
+
+				current = current->next; // left over from before a reset
+				offset = 0;
+			}
+
+			Block *block = NewBlock(std::max(nextBlockSize, size + alignment));
+			nextBlockSize *= 2;
+
+			if (current != nullptr)
+			{
+				current->next = block;
+			}
+			else
+			{
+				head = block;
+			}
+
+			current = block;
+			offset = 0;
+			return Allocate(size, alignment);
+		}
+
+		// Individual allocations aren't freed, that's what Reset() is for.
+		void Deallocate(void *, usize, usize) noexcept {}
+
+		/// @brief Everything handed out so far becomes invalid.
+		void Reset() noexcept
+		{
+			current = head;
+			offset = 0;
+		}
+
+		// Gives the blocks back to the heap as well.
+		void Release() noexcept
+		{
+			while (head != nullptr)
+			{
+				Block *next = head->next;
+				::operator delete(head);
+				head = next;
+			}
+
+			current = nullptr;
+			offset = 0;
+		}
+
+		~MonotonicArena()
+		{
+			Release();
+		}
+	};
+
+	/// @brief Equally sized slots carved out of chunks, with freed ones kept on an intrusive free list, for node-based containers and
+	/// objects that come and go a lot. Reset() forgets every slot in O(1) without running destructors. Not thread-safe.
+	class FixedPool final
+	{
+	private:
+		struct Chunk final
+		{
+		public:
+			Chunk *next;
+		};
+
+		struct FreeSlot final
+		{
+		public:
+			FreeSlot *next;
+		};
+
+		usize slotSize;
+		usize slotAlignment;
+		usize slotsPerChunk;
+		Chunk *head;
+		Chunk *current;
+		usize used; // slots of current handed out by bumping, the rest of the chunk has never been touched
+		FreeSlot *freeSlots;
+
+		usize GetHeaderSize() const noexcept
+		{
+			return AlignUp(sizeof(Chunk), slotAlignment);
+		}
+
+		byte *GetSlot(Chunk *chunk, usize index) const noexcept
+		{
+			return PtrCast<byte>(chunk) + GetHeaderSize() + index * slotSize;
+		}
+
+	public:
+		FixedPool(usize slotSize, usize slotAlignment, usize slotsPerChunk = 256) noexcept :
+			slotSize(AlignUp(std::max(slotSize, sizeof(FreeSlot)), std::max(slotAlignment, alignof(FreeSlot)))),
+			slotAlignment(std::max(slotAlignment, alignof(FreeSlot))), slotsPerChunk(std::max(slotsPerChunk, static_cast<usize>(1))),
+			head(nullptr), current(nullptr), used(0), freeSlots(nullptr) {}
+
+		FixedPool(const FixedPool &) = delete;
+		FixedPool &operator=(const FixedPool &) = delete;
+
+		usize GetSlotSize() const noexcept
+		{
+			return slotSize;
+		}
+
+		usize GetSlotAlignment() const noexcept
+		{
+			return slotAlignment;
+		}
+
+		[[nodiscard]]
+		void *Allocate()
+		{
+			if (freeSlots != nullptr)
+			{
+				return std::exchange(freeSlots, freeSlots->next);
+			}
+
+			if (current == nullptr || used == slotsPerChunk)
+			{
+				if (current != nullptr && current->next != nullptr)
+				{
+					current = current->next; // left over from before a reset
+				}
+				else
+				{
+					void *memory = ::operator new(GetHeaderSize() + slotSize * slotsPerChunk, std::align_val_t(slotAlignment));
+					Chunk *chunk = new (memory) Chunk { nullptr };
+					(current != nullptr ? current->next : head) = chunk;
+					current = chunk;
+				}
+
+				used = 0;
+			}
+
+			++used;
+			return GetSlot(current, used - 1);
+		}
+
+		void Deallocate(void *slot) noexcept
+		{
+			freeSlots = new (slot) FreeSlot { freeSlots };
+		}
+
+		void Reset() noexcept
+		{
+			current = head;
+			used = 0;
+			freeSlots = nullptr;
+		}
+
+		~FixedPool()
+		{
+			while (head != nullptr)
+			{
+				Chunk *next = head->next;
+				::operator delete(head, std::align_val_t(slotAlignment));
+				head = next;
+			}
+		}
+	};
+
+	template <typename T>
+	class ObjectPool final
+	{
+	private:
+		FixedPool pool;
+
+	public:
+		explicit ObjectPool(usize objectsPerChunk = 256) noexcept : pool(sizeof(T), alignof(T), objectsPerChunk) {}
+
+		template <typename ...TParams>
+		[[nodiscard]]
+		T *New(TParams &&...params)
+		{
+			void *slot = pool.Allocate();
+
+			try
+			{
+				return new (slot) T(std::forward<TParams>(params)...);
+			}
+			catch (...)
+			{
+				pool.Deallocate(slot);
+				throw;
+			}
+		}
+
+		void Delete(T *value) noexcept(noexcept(Lib::Memory::Destruct(*value)))
+		{
+			if (value != nullptr)
+			{
+				Lib::Memory::Destruct(*value);
+				pool.Deallocate(value);
+			}
+		}
+
+		// Objects still alive are forgotten, not destroyed.
+		void Reset() noexcept
+		{
+			pool.Reset();
+		}
+
+		FixedPool &GetPool() noexcept
+		{
+			return pool;
+		}
+	};
+
+	/// @brief Two arenas taking turns, so what was allocated during a frame stays valid through the next one too (e.g. for the
+	/// renderer to read) and then goes away in O(1) when NextFrame() comes around again.
+	class FrameArena final
+	{
+	private:
+		MonotonicArena arenas[2];
+		usize current;
+
+	public:
+		explicit FrameArena(usize blockSize = MonotonicArena::defaultBlockSize) noexcept : arenas { MonotonicArena(blockSize), MonotonicArena(blockSize) },
+			current(0) {}
+
+		[[nodiscard]]
+		void *Allocate(usize size, usize alignment = alignof(std::max_align_t))
+		{
+			return arenas[current].Allocate(size, alignment);
+		}
+
+		void Deallocate(void *, usize, usize) noexcept {}
+
+		// Call it at the top of every frame.
+		void NextFrame() noexcept
+		{
+			current ^= 1;
+			arenas[current].Reset();
+		}
+	};
+
+	namespace
+	{
+		inline void *AllocateFrom(MonotonicArena &arena, usize size, usize alignment)
+		{
+			return arena.Allocate(size, alignment);
+		}
+
+		inline void *AllocateFrom(FrameArena &arena, usize size, usize alignment)
+		{
+			return arena.Allocate(size, alignment);
+		}
+
+		// only single objects fit a slot, e.g. the nodes of a list or map, anything else goes to the heap
+		inline void *AllocateFrom(FixedPool &pool, usize size, usize alignment)
+		{
+			return size <= pool.GetSlotSize() && alignment <= pool.GetSlotAlignment() ? pool.Allocate() :
+				::operator new(size, std::align_val_t(alignment));
+		}
+
+		inline void DeallocateFrom(MonotonicArena &, void *, usize, usize) noexcept {}
+
+		inline void DeallocateFrom(FrameArena &, void *, usize, usize) noexcept {}
+
+		inline void DeallocateFrom(FixedPool &pool, void *ptr, usize size, usize alignment) noexcept
+		{
+			if (size <= pool.GetSlotSize() && alignment <= pool.GetSlotAlignment())
+			{
+				pool.Deallocate(ptr);
+			}
+			else
+			{
+				::operator delete(ptr, std::align_val_t(alignment));
+			}
+		}
+	}
+
+	/// @brief The allocator interface (what Collections::List, Collections::Array and std containers expect) over one of the
+	/// resources above. Copies and rebinds share the resource. A default constructed one has none and just uses the heap.
+	template <typename T, typename TResource>
+	struct ResourceAllocator
+	{
+	public:
+		using value_type = T;
+
+		TResource *resource;
+
+		constexpr ResourceAllocator() noexcept : resource(nullptr) {}
+		constexpr ResourceAllocator(TResource &resource) noexcept : resource(std::addressof(resource)) {}
+
+		template <typename TOther>
+		constexpr ResourceAllocator(const ResourceAllocator<TOther, TResource> &other) noexcept : resource(other.resource) {}
+
+		[[nodiscard]]
+		std::remove_const_t<T> *allocate(usize length) const
+		{
+			void *memory = resource != nullptr ? AllocateFrom(*resource, length * sizeof(T), alignof(T)) :
+				::operator new(length * sizeof(T), std::align_val_t(alignof(T)));
+			return static_cast<std::remove_const_t<T> *>(memory);
+		}
+
+		void deallocate(std::remove_const_t<T> *ptr, usize length) const noexcept
+		{
+			if (resource != nullptr)
+			{
+				DeallocateFrom(*resource, ptr, length * sizeof(T), alignof(T));
+			}
+			else
+			{
+				::operator delete(ptr, std::align_val_t(alignof(T)));
+			}
+		}
+
+		template <typename TOther>
+		constexpr friend bool operator==(const ResourceAllocator &lhs, const ResourceAllocator<TOther, TResource> &rhs) noexcept
+		{
+			return lhs.resource == rhs.resource;
+		}
+
+		template <typename TOther>
+		constexpr friend bool operator!=(const ResourceAllocator &lhs, const ResourceAllocator<TOther, TResource> &rhs) noexcept
+		{
+			return lhs.resource != rhs.resource;
+		}
+	};
+
+	template <typename T>
+	using ArenaAllocator = ResourceAllocator<T, MonotonicArena>;
+
+	template <typename T>
+	using PoolAllocator = ResourceAllocator<T, FixedPool>;
+
+	template <typename T>
+	using FrameAllocator = ResourceAllocator<T, FrameArena>;
+
+	/// @brief The calling thread's scratch memory for short lived results (cleared lines, HUD text and such), handed out as
+	/// spans and string views instead of fresh vectors and strings. Anything taken from it stays valid until the second
+	/// NextScratchFrame() after it, so a frame can still read what the previous one (or the last tick) produced.
+	inline FrameArena &GetScratchArena() noexcept
+	{
+		thread_local FrameArena arena = FrameArena();
+		return arena;
+	}
+
+	// Call it at the top of every frame or simulation tick, on the thread that ran it.
+	inline void NextScratchFrame() noexcept
+	{
+		GetScratchArena().NextFrame();
+	}
+
+	/// @brief Value initialized storage for length values from the scratch arena. Nothing is destroyed on reset, hence the requirement.
+	template <typename T> requires std::is_trivially_destructible_v<T>
+	std::span<T> ScratchArray(usize length)
+	{
+		if (length == 0)
+		{
+			return std::span<T>();
+		}
+
+		T *data = static_cast<T *>(GetScratchArena().Allocate(length * sizeof(T), alignof(T)));
+		std::uninitialized_value_construct_n(data, length);
+		return std::span<T>(data, length);
+	}
+
+	template <typename T> requires std::is_trivially_copyable_v<T>
+	std::span<T> ScratchCopy(std::span<const T> values)
+	{
+		std::span<T> result = ScratchArray<T>(values.size());
+
+		if (!values.empty())
+		{
+			std::memcpy(result.data(), values.data(), values.size_bytes());
+		}
+
+		return result;
+	}
+
+	/// @brief One piece of a ScratchText, either text or a number formatted in place.
+	struct TextPart final
+	{
+	private:
+		std::string_view text;
+		char digits[24];
+		usize digitCount;
+
+	public:
+		TextPart(std::string_view text) noexcept : text(text), digits(), digitCount(0) {}
+		TextPart(const char *text) noexcept : TextPart(std::string_view(text)) {}
+		TextPart(const string &text) noexcept : TextPart(std::string_view(text)) {}
+		TextPart(char character) noexcept : text(), digits { character }, digitCount(1) {}
+
+		template <std::integral TNumber>
+		TextPart(TNumber number) noexcept : text(), digits(), digitCount(0)
+		{
+			digitCount = static_cast<usize>(std::to_chars(digits, digits + sizeof(digits), number).ptr - digits);
+		}
+
+		// Worked out on demand rather than kept in text, which would point at the digits of whatever copy it was made from.
+		std::string_view Get() const noexcept
+		{
+			return digitCount > 0 ? std::string_view(digits, digitCount) : text;
+		}
+	};
+
+	/// @brief Concatenates parts into the scratch arena, e.g. ScratchText({ "B2B x", b2b }). The result is null terminated,
+	/// so its data() can go straight to C APIs like SDL_ttf.
+	inline std::string_view ScratchText(std::initializer_list<TextPart> parts)
+	{
+		usize length = 0;
+
+		for (const TextPart &part : parts)
+		{
+			length += part.Get().size();
+		}
+
+		char *data = static_cast<char *>(GetScratchArena().Allocate(length + 1, alignof(char)));
+		char *end = data;
+
+		for (const TextPart &part : parts)
+		{
+			std::string_view text = part.Get();
+			end = std::copy(text.begin(), text.end(), end);
+		}
+
+		*end = '\0';
+		return std::string_view(data, length);
+	}
 }
 
 namespace Lib::Memory::Unsafe
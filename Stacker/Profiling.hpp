@@ -0,0 +1,242 @@
+#ifndef PROFILING_DEFINED
+#define PROFILING_DEFINED
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+#include "Lib.hpp"
+#include "Time.hpp"
+
+namespace Lib::Profiling
+{
+	using namespace Lib;
+	using namespace Lib::Time;
+
+	using ProfileClock = std::chrono::steady_clock;
+
+	struct PhaseTime final
+	{
+	public:
+		const char *name; // must outlive the profiler, string literals are the intended use
+		DeltaTime time;
+	};
+
+	struct TraceEvent final
+	{
+	public:
+		const char *name;
+		ProfileClock::time_point start;
+		ProfileClock::time_point end;
+		int threadId; // which track of the trace it goes on
+	};
+
+	class FrameProfiler;
+
+	struct ScopedTimer final
+	{
+	private:
+		FrameProfiler *profiler;
+		const char *name;
+		ProfileClock::time_point start;
+
+	public:
+		ScopedTimer(FrameProfiler &profiler, const char *name) noexcept : profiler(std::addressof(profiler)), name(name),
+			start(ProfileClock::now()) {}
+
+		ScopedTimer(const ScopedTimer &) = delete;
+		ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+		~ScopedTimer();
+	};
+
+	// Keeps a rolling window of frame times plus the per-phase breakdown of the last finished frame.
+	// Can additionally record every scope into a Chrome trace (chrome://tracing or https://ui.perfetto.dev).
+	class FrameProfiler final
+	{
+	public:
+		static constexpr usize historyLength = 240;
+		static constexpr usize maxPhases = 16;
+		static constexpr usize maxTraceEvents = static_cast<usize>(1) << 20; // roughly 32 MiB, stops recording silently after that
+		static constexpr int mainThreadId = 1; // the trace track of everything timed with Scope()
+
+	private:
+		std::array<DeltaTime, historyLength> frameTimes;
+		std::array<PhaseTime, maxPhases> currentPhases;
+		std::array<PhaseTime, maxPhases> previousPhases;
+		std::vector<TraceEvent> traceEvents;
+		ProfileClock::time_point frameStart;
+		ProfileClock::time_point traceStart;
+		usize frameIndex;
+		usize frameCount;
+		usize currentPhaseCount;
+		usize previousPhaseCount;
+		bool tracing;
+
+	public:
+		FrameProfiler() noexcept : frameTimes(), currentPhases(), previousPhases(), traceEvents(), frameStart(ProfileClock::now()),
+			traceStart(frameStart), frameIndex(0), frameCount(0), currentPhaseCount(0), previousPhaseCount(0), tracing(false) {}
+
+		usize GetFrameCount() const noexcept
+		{
+			return std::min(frameCount, historyLength);
+		}
+
+		// index 0 is the oldest frame still in the window
+		DeltaTime GetFrameTime(usize index) const noexcept
+		{
+			usize count = GetFrameCount();
+			return frameTimes[(frameIndex + historyLength - count + index) % historyLength];
+		}
+
+		DeltaTime GetLastFrameTime() const noexcept
+		{
+			return frameCount > 0 ? frameTimes[(frameIndex + historyLength - 1) % historyLength] : DeltaTime();
+		}
+
+		const PhaseTime *GetPhases() const noexcept
+		{
+			return previousPhases.data();
+		}
+
+		usize GetPhaseCount() const noexcept
+		{
+			return previousPhaseCount;
+		}
+
+		bool IsTracing() const noexcept
+		{
+			return tracing;
+		}
+
+		/// @brief Returns the frame time at the given percentile (0.0 to 1.0) over the rolling window.
+		DeltaTime GetPercentile(double percentile) const noexcept
+		{
+			usize count = GetFrameCount();
+
+			if (count == 0)
+			{
+				return DeltaTime();
+			}
+
+			std::array<DeltaTime, historyLength> sorted = frameTimes;
+			usize index = std::min(static_cast<usize>(percentile * static_cast<double>(count)), count - 1);
+			std::nth_element(sorted.begin(), sorted.begin() + index, sorted.begin() + count);
+			return sorted[index];
+		}
+
+		void BeginFrame() noexcept
+		{
+			frameStart = ProfileClock::now();
+			currentPhaseCount = 0;
+		}
+
+		void EndFrame() noexcept
+		{
+			ProfileClock::time_point frameEnd = ProfileClock::now();
+			frameTimes[frameIndex] = std::chrono::duration_cast<std::chrono::duration<DeltaTime>>(frameEnd - frameStart).count();
+			frameIndex = (frameIndex + 1) % historyLength;
+			++frameCount;
+			previousPhases = currentPhases;
+			previousPhaseCount = currentPhaseCount;
+			Trace("Frame", frameStart, frameEnd, mainThreadId);
+		}
+
+		void Record(const char *name, ProfileClock::time_point start, ProfileClock::time_point end) noexcept
+		{
+			AddPhaseTime(name, std::chrono::duration_cast<std::chrono::duration<DeltaTime>>(end - start).count());
+			Trace(name, start, end, mainThreadId);
+		}
+
+		/// @brief For work timed on another thread and handed over: time counts toward this frame's phase, which can be more than the
+		/// one span [start, end] that goes in the trace, on a track of its own.
+		void Record(const char *name, DeltaTime time, ProfileClock::time_point start, ProfileClock::time_point end, int threadId) noexcept
+		{
+			AddPhaseTime(name, time);
+			Trace(name, start, end, threadId);
+		}
+
+		ScopedTimer Scope(const char *name) noexcept
+		{
+			return ScopedTimer(*this, name);
+		}
+
+		void StartTrace()
+		{
+			traceEvents.clear();
+			traceEvents.reserve(4096);
+			traceStart = ProfileClock::now();
+			tracing = true;
+		}
+
+		void StopTrace() noexcept
+		{
+			tracing = false;
+		}
+
+		/// @brief Writes everything recorded since StartTrace() in the Chrome trace event format.
+		/// @return Whether the file could be written
+		bool WriteTrace(const string &path) const
+		{
+			std::ofstream stream = std::ofstream(path);
+
+			if (!stream)
+			{
+				return false;
+			}
+
+			stream << "{\"traceEvents\":[\n";
+
+			for (usize i = 0; i < traceEvents.size(); ++i)
+			{
+				const TraceEvent &traceEvent = traceEvents[i];
+				double start = std::chrono::duration<double, std::micro>(traceEvent.start - traceStart).count();
+				double duration = std::chrono::duration<double, std::micro>(traceEvent.end - traceEvent.start).count();
+
+				stream << "{\"name\":\"" << traceEvent.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << traceEvent.threadId << ",\"ts\":" << start <<
+					",\"dur\":" << duration << '}' << (i + 1 < traceEvents.size() ? ",\n" : "\n");
+			}
+
+			stream << "],\"displayTimeUnit\":\"ms\"}\n";
+			return static_cast<bool>(stream);
+		}
+
+	private:
+		void AddPhaseTime(const char *name, DeltaTime time) noexcept
+		{
+			for (usize i = 0; i < currentPhaseCount; ++i) // the same phase can run more than once a frame, e.g. event polling
+			{
+				if (currentPhases[i].name == name)
+				{
+					currentPhases[i].time += time;
+					return;
+				}
+			}
+
+			if (currentPhaseCount < maxPhases)
+			{
+				currentPhases[currentPhaseCount] = PhaseTime { name, time };
+				++currentPhaseCount;
+			}
+		}
+
+		void Trace(const char *name, ProfileClock::time_point start, ProfileClock::time_point end, int threadId) noexcept
+		{
+			if (tracing && traceEvents.size() < maxTraceEvents)
+			{
+				traceEvents.push_back(TraceEvent { name, start, end, threadId });
+			}
+		}
+	};
+
+	inline ScopedTimer::~ScopedTimer()
+	{
+		profiler->Record(name, start, ProfileClock::now());
+	}
+}
+
+#endif // !PROFILING_DEFINED
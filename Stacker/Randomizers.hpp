@@ -4,11 +4,21 @@
 #pragma once
 
 #include <random>
+#include <cstdint>
 
 #include "Lib.hpp"
 
 namespace Lib::Randomizers
 {
+	// Small and fast, and usable at compile time, which makes it handy for filling hash key tables or seeding other generators.
+	constexpr std::uint64_t SplitMix64(std::uint64_t &state) noexcept
+	{
+		std::uint64_t result = (state += 0x9E3779B97F4A7C15);
+		result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9;
+		result = (result ^ (result >> 27)) * 0x94D049BB133111EB;
+		return result ^ (result >> 31);
+	}
+
 	class Randomizer final
 	{
 	private:
@@ -59,6 +69,12 @@ namespace Lib::Randomizers
 			Shuffle();
 		}
 
+		// Same seed, same piece sequence. Useful for replays and benchmarks.
+		BagRandomizer(const std::vector<T> &bag, usize seed) : bag(std::vector<T>(bag)), index(0), randomizer(std::mt19937_64(seed))
+		{
+			Shuffle();
+		}
+
 		BagRandomizer(std::initializer_list<T> bag) : bag(std::vector<T>(bag)), index(0), randomizer(std::mt19937_64(std::random_device()())) {}
 
 		usize size() const noexcept
@@ -71,7 +87,8 @@ namespace Lib::Randomizers
 			return index;
 		}
 
-		std::vector<T> GetBag() const noexcept
+		// The whole shuffled bag, the values from GetIndex() on are the ones still to come.
+		const std::vector<T> &GetBag() const noexcept
 		{
 			return bag;
 		}
@@ -149,6 +149,11 @@ namespace Lib::Data
 		return { topLeftCornerPosition.x, topLeftCornerPosition.y, width, height };
 	}
 
+	constexpr SDL_Rect RectWithTopLeftPosition(int2 topLeftPosition, RectSize size) noexcept
+	{
+		return { topLeftPosition.x, topLeftPosition.y, size.width, size.height };
+	}
+
 	constexpr SDL_Rect RectWithTopRightPosition(int2 topRightPosition, RectSize size) noexcept
 	{
 		return { topRightPosition.x - size.width, topRightPosition.y, size.width, size.height };
@@ -263,6 +268,34 @@ namespace Lib::Sdl
 		return SDL_PollEvent(std::addressof(event));
 	}
 
+	// Blocks the thread until an event arrives or the timeout (in milliseconds) runs out. Returns 0 on timeout.
+	int WaitEventTimeout(SDL_Event *event, int timeout)
+	{
+		return SDL_WaitEventTimeout(event, timeout);
+	}
+
+	int WaitEventTimeout(SDL_Event &event, int timeout)
+	{
+		return SDL_WaitEventTimeout(std::addressof(event), timeout);
+	}
+
+	// Safe to call from any thread, e.g. to wake one blocked in WaitEventTimeout(). Returns 1 if the event was queued.
+	int PushEvent(SDL_Event &event)
+	{
+		return SDL_PushEvent(std::addressof(event));
+	}
+
+	// Reserves count event types for the program's own events. Returns the first one, or (Uint32)-1 if there aren't enough left.
+	Uint32 RegisterEvents(int count)
+	{
+		return SDL_RegisterEvents(count);
+	}
+
+	constexpr bool IsWindowEvent(const SDL_Event &event, SDL_WindowEventID windowEvent) noexcept
+	{
+		return event.type == SDL_EventType::SDL_WINDOWEVENT && event.window.event == static_cast<Uint8>(windowEvent);
+	}
+
 	const char *GetBasePath()
 	{
 		return SDL_GetBasePath();
@@ -350,6 +383,7 @@ namespace Lib::Sdl
 		{
 			SDL_Surface *temp = other.surface;
 			other.surface = nullptr;
+			SDL_FreeSurface(surface);
 			surface = temp;
 			return *this;
 		}
@@ -359,6 +393,16 @@ namespace Lib::Sdl
 			return surface;
 		}
 
+		RectSize GetSize() const noexcept
+		{
+			return { surface->w, surface->h };
+		}
+
+		int SavePng(const string &path) const
+		{
+			return IMG_SavePNG(surface, path.c_str());
+		}
+
 		SDL_Surface *operator->() const noexcept
 		{
 			return surface;
@@ -674,6 +718,21 @@ namespace Lib::Sdl
 			return SDL_SetRenderDrawBlendMode(renderer, blendMode);
 		}
 
+		int RenderFillRect(const SDL_Rect *rect)
+		{
+			return SDL_RenderFillRect(renderer, rect);
+		}
+
+		int RenderFillRect(const SDL_Rect &rect)
+		{
+			return SDL_RenderFillRect(renderer, &rect);
+		}
+
+		int RenderDrawLine(int2 start, int2 end)
+		{
+			return SDL_RenderDrawLine(renderer, start.x, start.y, end.x, end.y);
+		}
+
 		void RenderClear()
 		{
 			SDL_RenderClear(renderer);
@@ -702,7 +761,7 @@ namespace Lib::Sdl
 	public:
 		Sprite() noexcept = default;
 		Sprite(SDL_Texture *texture) : texture(MakeShared<Texture>(texture)), imageSize(this->texture->GetSize()) {}
-		Sprite(Texture &&texture) : texture(SharedPtr<Texture>(std::move(texture))), imageSize(this->texture->GetSize()) {}
+		Sprite(Texture &&texture) : texture(MakeShared<Texture>(std::move(texture))), imageSize(this->texture->GetSize()) {}
 
 		RectSize GetSize() const noexcept
 		{
@@ -911,6 +970,68 @@ namespace Lib::Sdl
 	{
 		return SDL_CreateWindowAndRenderer(width, height, windowFlags, &window.window, &renderer.renderer);
 	}
+
+	// Call before SDL_Init so no display is needed at all. Pairs with CreateHeadlessRenderer.
+	void UseDummyVideoDriver()
+	{
+		SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+	}
+
+	/// @brief Creates a software renderer drawing into an offscreen RGBA surface instead of a window.
+	/// Everything that takes an SDL_Renderer * (TileMap, TextRenderGuide, Texture...) works on it unchanged.
+	/// @return 0 on success, -1 otherwise (see SDL_GetError)
+	int CreateHeadlessRenderer(int width, int height, Surface &surface, Renderer &renderer)
+	{
+		surface = Surface(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32));
+
+		if (!surface)
+		{
+			return -1;
+		}
+
+		renderer = Renderer(SDL_CreateSoftwareRenderer(surface));
+		return renderer ? 0 : -1;
+	}
+
+	/// @brief Counts the pixels whose channels differ by more than tolerance. Meant for golden image checks.
+	/// @return The number of differing pixels, or -1 if the sizes don't match or a conversion failed
+	long long CountDifferentPixels(SDL_Surface *lhs, SDL_Surface *rhs, int tolerance)
+	{
+		if (lhs == nullptr || rhs == nullptr || lhs->w != rhs->w || lhs->h != rhs->h)
+		{
+			return -1;
+		}
+
+		Surface lhsRgba = Surface(SDL_ConvertSurfaceFormat(lhs, SDL_PIXELFORMAT_RGBA32, 0));
+		Surface rhsRgba = Surface(SDL_ConvertSurfaceFormat(rhs, SDL_PIXELFORMAT_RGBA32, 0));
+
+		if (!lhsRgba || !rhsRgba)
+		{
+			return -1;
+		}
+
+		long long result = 0;
+
+		for (int y = 0; y < lhsRgba->h; ++y)
+		{
+			const Uint8 *lhsRow = static_cast<const Uint8 *>(lhsRgba->pixels) + y * lhsRgba->pitch;
+			const Uint8 *rhsRow = static_cast<const Uint8 *>(rhsRgba->pixels) + y * rhsRgba->pitch;
+
+			for (int x = 0; x < lhsRgba->w * 4; x += 4)
+			{
+				for (int channel = 0; channel < 4; ++channel)
+				{
+					if (Abs(static_cast<int>(lhsRow[x + channel]) - static_cast<int>(rhsRow[x + channel])) > tolerance)
+					{
+						++result;
+						break;
+					}
+				}
+			}
+		}
+
+		return result;
+	}
 }
 
 namespace Lib::Sdl::Text
@@ -954,34 +1075,55 @@ namespace Lib::Sdl::Text
 			TTF_SetFontWrappedAlign(font, align);
 		}
 
-		RectSize SizeText(const string &text) const
+		// The const char * overloads take anything null terminated, e.g. the string views made by Memory::Allocation::ScratchText.
+		RectSize SizeText(const char *text) const
 		{
 			RectSize result = {};
-			TTF_SizeText(font, text.c_str(), &result.width, &result.height);
+			TTF_SizeText(font, text, &result.width, &result.height);
 			return result;
 		}
 
-		RectSize SizeUtf8(const string &text) const
+		RectSize SizeText(const string &text) const
+		{
+			return SizeText(text.c_str());
+		}
+
+		RectSize SizeUtf8(const char *text) const
 		{
 			RectSize result = {};
-			TTF_SizeUTF8(font, text.c_str(), &result.width, &result.height);
+			TTF_SizeUTF8(font, text, &result.width, &result.height);
 			return result;
 		}
 
-		void RenderText(const string &text, SDL_Color color, SDL_Renderer *renderer, const SDL_Rect *srcRect, const SDL_Rect *dstRect) const
+		RectSize SizeUtf8(const string &text) const
+		{
+			return SizeUtf8(text.c_str());
+		}
+
+		void RenderText(const char *text, SDL_Color color, SDL_Renderer *renderer, const SDL_Rect *srcRect, const SDL_Rect *dstRect) const
 		{
-			Surface surface = Surface(TTF_RenderText_Blended(font, text.c_str(), color));
+			Surface surface = Surface(TTF_RenderText_Blended(font, text, color));
 			Texture texture = Texture(renderer, surface);
 			SDL_RenderCopy(renderer, texture, srcRect, dstRect);
 		}
 
-		void RenderUtf8(const string &text, SDL_Color color, SDL_Renderer *renderer, const SDL_Rect *srcRect, const SDL_Rect *dstRect) const
+		void RenderText(const string &text, SDL_Color color, SDL_Renderer *renderer, const SDL_Rect *srcRect, const SDL_Rect *dstRect) const
+		{
+			RenderText(text.c_str(), color, renderer, srcRect, dstRect);
+		}
+
+		void RenderUtf8(const char *text, SDL_Color color, SDL_Renderer *renderer, const SDL_Rect *srcRect, const SDL_Rect *dstRect) const
 		{
-			Surface surface = Surface(TTF_RenderUTF8_Blended(font, text.c_str(), color));
+			Surface surface = Surface(TTF_RenderUTF8_Blended(font, text, color));
 			Texture texture = Texture(renderer, surface);
 			SDL_RenderCopy(renderer, texture, srcRect, dstRect);
 		}
 
+		void RenderUtf8(const string &text, SDL_Color color, SDL_Renderer *renderer, const SDL_Rect *srcRect, const SDL_Rect *dstRect) const
+		{
+			RenderUtf8(text.c_str(), color, renderer, srcRect, dstRect);
+		}
+
 		void RenderText(const string &text, SDL_Color color, SDL_Renderer *renderer, Nullable<const SDL_Rect> srcRect, Nullable<const SDL_Rect> dstRect) const
 		{
 			RenderText(text, color, renderer, srcRect.operator->(), dstRect.operator->());
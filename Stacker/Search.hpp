@@ -0,0 +1,1633 @@
+#ifndef SEARCH_DEFINED
+#define SEARCH_DEFINED
+
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <limits>
+#include <array>
+#include <vector>
+#include <span>
+
+#include "Lib.hpp"
+#include "Randomizers.hpp"
+#include "Threading.hpp"
+#include "Stacker.hpp"
+
+namespace Stacker::Search
+{
+	using namespace Lib;
+	using Lib::Threading::Scheduler;
+
+	// Where a piece ends up: the offset of its rotation state from the kick table's one, its orientation,
+	// and whether it was swapped with the hold first.
+	struct Placement final
+	{
+	public:
+		int2 offset;
+		Orientation orientation;
+		bool hold;
+
+		static constexpr Placement None() noexcept
+		{
+			return { int2 { std::numeric_limits<std::int8_t>::min(), std::numeric_limits<std::int8_t>::min() }, Orientation::North, false };
+		}
+
+		constexpr bool IsNone() const noexcept
+		{
+			return offset.x == std::numeric_limits<std::int8_t>::min();
+		}
+
+		// 19 bits: 8 for each offset component, 2 for the orientation, 1 for hold
+		constexpr std::uint32_t Pack() const noexcept
+		{
+			return static_cast<std::uint32_t>(static_cast<std::uint8_t>(offset.x)) | (static_cast<std::uint32_t>(static_cast<std::uint8_t>(offset.y)) << 8) |
+				(static_cast<std::uint32_t>(orientation) << 16) | (static_cast<std::uint32_t>(hold) << 18);
+		}
+
+		static constexpr Placement Unpack(std::uint32_t value) noexcept
+		{
+			return
+			{
+				int2 { static_cast<std::int8_t>(value & 0xFF), static_cast<std::int8_t>((value >> 8) & 0xFF) },
+				static_cast<Orientation>((value >> 16) & 0x3),
+				((value >> 18) & 0x1) != 0
+			};
+		}
+
+		TetrominoState GetState(const Tetromino &tetromino) const noexcept
+		{
+			return tetromino.kickTable->GetState(orientation) + offset;
+		}
+
+		constexpr friend bool operator==(const Placement &lhs, const Placement &rhs) noexcept
+		{
+			return lhs.Pack() == rhs.Pack();
+		}
+	};
+
+	using PlacementList = Lib::Collections::SmallList<Placement, 10>; // a 4 line perfect clear takes 10 pieces
+
+	struct TranspositionEntry final
+	{
+	public:
+		float score;
+		Placement bestPlacement;
+		int depth; // how many pieces deep the score was searched
+	};
+
+	/// @brief Fixed-size hash table of evaluated positions, shared by any number of threads without locks. Callers bring their own
+	/// 64-bit keys, made from whatever tells their positions apart.
+	/// Buckets are one cache line of 4 entries. Each entry stores key ^ data next to data, so a torn write from two threads racing on
+	/// the same entry just reads back as a miss (Hyatt's lockless hashing) instead of handing out another position's score.
+	/// When a bucket is full, the entry with the least depth goes, with entries from older searches counting as shallower.
+	class TranspositionTable final
+	{
+	public:
+		static constexpr usize entriesPerBucket = 4;
+		static constexpr int maxDepth = 63;
+
+	private:
+		// data layout: score (32 bits, a float) | placement (19 bits) | depth (6 bits) | age (6 bits) | occupied (1 bit)
+		// The occupied bit keeps a stored entry apart from a cleared one even if everything else packs to 0.
+		struct Entry final
+		{
+		public:
+			std::atomic<std::uint64_t> keyXorData;
+			std::atomic<std::uint64_t> data;
+		};
+
+		struct alignas(64) Bucket final
+		{
+		public:
+			Entry entries[entriesPerBucket];
+		};
+
+		static_assert(sizeof(Bucket) == 64, "A bucket should be exactly one cache line");
+
+		static constexpr int ageBits = 6;
+		static constexpr std::uint64_t ageMask = (static_cast<std::uint64_t>(1) << ageBits) - 1;
+		static constexpr std::uint64_t occupiedBit = static_cast<std::uint64_t>(1) << 63;
+
+		std::unique_ptr<Bucket[]> buckets;
+		usize bucketMask;
+		std::atomic<std::uint32_t> age;
+
+		static constexpr std::uint64_t PackData(float score, Placement bestPlacement, int depth, std::uint32_t age) noexcept
+		{
+			return static_cast<std::uint64_t>(std::bit_cast<std::uint32_t>(score)) | (static_cast<std::uint64_t>(bestPlacement.Pack()) << 32) |
+				(static_cast<std::uint64_t>(std::clamp(depth, 0, maxDepth)) << 51) | ((static_cast<std::uint64_t>(age) & ageMask) << 57) | occupiedBit;
+		}
+
+		static constexpr bool IsOccupied(std::uint64_t data) noexcept
+		{
+			return (data & occupiedBit) != 0;
+		}
+
+		static constexpr int GetDepth(std::uint64_t data) noexcept
+		{
+			return static_cast<int>((data >> 51) & 0x3F);
+		}
+
+		static constexpr std::uint32_t GetAge(std::uint64_t data) noexcept
+		{
+			return static_cast<std::uint32_t>((data >> 57) & ageMask);
+		}
+
+		// lower is replaced first
+		int GetWorth(std::uint64_t data, std::uint32_t currentAge) const noexcept
+		{
+			int relativeAge = static_cast<int>((currentAge - GetAge(data)) & ageMask);
+			return GetDepth(data) - relativeAge * 4;
+		}
+
+	public:
+		/// @param megabytes Rounded down to a power of two worth of buckets, at least one
+		explicit TranspositionTable(usize megabytes) : buckets(), bucketMask(0), age(0)
+		{
+			usize bucketCount = std::bit_floor(std::max(megabytes * 1024 * 1024 / sizeof(Bucket), static_cast<usize>(1)));
+			buckets = std::make_unique<Bucket[]>(bucketCount);
+			bucketMask = bucketCount - 1;
+		}
+
+		TranspositionTable(const TranspositionTable &) = delete;
+		TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+		usize size() const noexcept
+		{
+			return (bucketMask + 1) * entriesPerBucket;
+		}
+
+		// Call once per search (e.g. per piece placed), so entries from earlier searches get replaced first.
+		void NewSearch() noexcept
+		{
+			age.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Not thread-safe, only call it while no search is running.
+		void Clear() noexcept
+		{
+			for (usize i = 0; i <= bucketMask; ++i)
+			{
+				for (Entry &entry : buckets[i].entries)
+				{
+					entry.keyXorData.store(0, std::memory_order_relaxed);
+					entry.data.store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool Probe(std::uint64_t key, TranspositionEntry &result) const noexcept
+		{
+			const Bucket &bucket = buckets[key & bucketMask];
+
+			for (const Entry &entry : bucket.entries)
+			{
+				std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+
+				if (IsOccupied(data) && (entry.keyXorData.load(std::memory_order_relaxed) ^ data) == key)
+				{
+					result = TranspositionEntry
+					{
+						std::bit_cast<float>(static_cast<std::uint32_t>(data)),
+						Placement::Unpack(static_cast<std::uint32_t>((data >> 32) & 0x7FFFF)),
+						GetDepth(data)
+					};
+
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void Store(std::uint64_t key, float score, Placement bestPlacement, int depth) noexcept
+		{
+			Bucket &bucket = buckets[key & bucketMask];
+			std::uint32_t currentAge = age.load(std::memory_order_relaxed);
+			Entry *replaced = nullptr;
+			int replacedWorth = std::numeric_limits<int>::max();
+
+			// The same key goes back where it already is, wherever in the bucket that is, so a bucket never holds it twice
+			for (Entry &entry : bucket.entries)
+			{
+				std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+
+				if (IsOccupied(data) && (entry.keyXorData.load(std::memory_order_relaxed) ^ data) == key)
+				{
+					if (GetDepth(data) > depth && GetAge(data) == (currentAge & ageMask))
+					{
+						return; // already searched deeper during this search
+					}
+
+					replaced = std::addressof(entry);
+					break;
+				}
+
+				int worth = IsOccupied(data) ? GetWorth(data, currentAge) : std::numeric_limits<int>::min(); // an empty entry goes first
+
+				if (worth < replacedWorth)
+				{
+					replaced = std::addressof(entry);
+					replacedWorth = worth;
+				}
+			}
+
+			std::uint64_t data = PackData(score, bestPlacement, depth, currentAge);
+			replaced->keyXorData.store(key ^ data, std::memory_order_relaxed);
+			replaced->data.store(data, std::memory_order_relaxed);
+		}
+	};
+
+	// The cells and kicks of a tetromino flattened out of its KickTable, so generating placements never goes through an unordered_map.
+	struct PieceShape final
+	{
+	public:
+		static constexpr usize rotateDirectionCount = 4;
+		static constexpr usize maxKicks = 6;
+		static constexpr RotateDirection rotateDirections[rotateDirectionCount] =
+		{
+			RotateDirection::Clockwise, RotateDirection::Counterclockwise, RotateDirection::Clockwise180, RotateDirection::Counterclockwise180
+		};
+
+		TetrominoType tetrominoType;
+		TetrominoState states[orientationCount];
+		int2 kicks[orientationCount][rotateDirectionCount][maxKicks];
+		usize kickCounts[orientationCount][rotateDirectionCount];
+
+		static PieceShape New(const Tetromino &tetromino)
+		{
+			PieceShape result = PieceShape();
+			result.tetrominoType = tetromino.tetrominoType;
+
+			for (int orientation = 0; orientation < orientationCount; ++orientation)
+			{
+				result.states[orientation] = tetromino.kickTable->GetState(static_cast<Orientation>(orientation));
+
+				for (usize direction = 0; direction < rotateDirectionCount; ++direction)
+				{
+					const KickList &kicks = tetromino.kickTable->GetKicks(RotationChange { static_cast<Orientation>(orientation), rotateDirections[direction] });
+					result.kickCounts[orientation][direction] = std::min(kicks.size(), maxKicks);
+					std::copy_n(kicks.begin(), result.kickCounts[orientation][direction], result.kicks[orientation][direction]);
+				}
+			}
+
+			return result;
+		}
+
+		// Indexed by GetTetrominoIndex(), built once from tetrominoVector.
+		static const std::array<PieceShape, 8> &GetAll()
+		{
+			static const std::array<PieceShape, 8> shapes = []() -> std::array<PieceShape, 8>
+			{
+				std::array<PieceShape, 8> result = std::array<PieceShape, 8>();
+
+				for (const Tetromino &tetromino : tetrominoVector)
+				{
+					result[GetTetrominoIndex(tetromino.tetrominoType)] = New(tetromino);
+				}
+
+				return result;
+			}();
+
+			return shapes;
+		}
+	};
+
+	/// @brief Searches for a sequence of placements that empties the board within a given number of lines, using the current piece,
+	/// the next queue and the hold. The bottom lines are kept as one 64-bit mask (bit row * Width + column), so at most 64 / Width
+	/// lines are searched. Subtrees of the first placement are searched in parallel and dead ends are remembered in a shared
+	/// TranspositionTable, which can be reused across calls.
+	/// Branches are cut when the empty cells can't be split into tetrominoes: a cell count that isn't a multiple of 4 (per side of
+	/// a filled column too), more cells than the remaining pieces cover, a column parity the remaining pieces can't even out, or
+	/// holes smaller than a piece sealed in rows that can never clear.
+	template <const int Width>
+	class PerfectClearFinder final
+	{
+	public:
+		static constexpr int maxLines = 64 / Width;
+
+	private:
+		static_assert(maxLines >= 1, "A row has to fit a 64-bit mask");
+
+		static constexpr std::uint64_t fullRow = ~static_cast<std::uint64_t>(0) >> (64 - Width);
+		static constexpr int offsetPadding = 3; // every state's cells are within 0 to 3 of its offset
+		static constexpr int offsetColumns = Width + offsetPadding;
+		static constexpr int offsetRows = maxLines + offsetPadding * 2;
+		static constexpr usize stateCount = static_cast<usize>(orientationCount * offsetColumns * offsetRows);
+
+		struct Landing final
+		{
+		public:
+			Placement placement;
+			std::uint64_t mask;
+		};
+
+		struct Option final
+		{
+		public:
+			usize shapeIndex;
+			usize next;
+			usize held;
+			bool hold;
+		};
+
+		enum struct SearchResult : unsigned char
+		{
+			NotFound,
+			Found,
+			Aborted,
+		};
+
+		// Per thread, so nothing here is shared.
+		struct SearchContext final
+		{
+		public:
+			PlacementList path;
+			std::vector<std::vector<Landing>> landings; // one list per depth, reused
+			usize rootIndex;
+		};
+
+		TranspositionTable *table;
+		Scheduler *scheduler;
+		std::vector<SearchContext> contexts; // one per worker of the scheduler, the last one for the thread calling Find()
+		std::vector<usize> pieces; // GetTetrominoIndex() of the current piece followed by the next queue
+		std::vector<std::uint64_t> queueKeys; // queueKeys[i] stands for pieces[i..]
+		std::atomic<usize> solvedRootIndex;
+
+		static constexpr std::uint64_t LowBits(int count) noexcept
+		{
+			return count >= 64 ? ~static_cast<std::uint64_t>(0) : (static_cast<std::uint64_t>(1) << count) - 1;
+		}
+
+		static constexpr std::uint64_t ShiftDown(std::uint64_t value, int count) noexcept
+		{
+			return count >= 64 ? 0 : value >> count;
+		}
+
+		static constexpr std::uint64_t ShiftUp(std::uint64_t value, int count) noexcept
+		{
+			return count >= 64 ? 0 : value << count;
+		}
+
+		static std::uint64_t Mix(std::uint64_t value) noexcept
+		{
+			return Randomizers::SplitMix64(value);
+		}
+
+		static constexpr usize GetStateIndex(int orientation, int2 offset) noexcept
+		{
+			return static_cast<usize>((orientation * offsetColumns + offset.x + offsetPadding) * offsetRows + offset.y + offsetPadding);
+		}
+
+		// A piece state as a field mask anchored at its lowest and leftmost cells, so putting it anywhere is one shift.
+		struct StateMask final
+		{
+		public:
+			std::uint64_t mask;
+			int2 mins;
+			int2 maxes;
+		};
+
+		// Indexed by GetTetrominoIndex() and orientation.
+		static const std::array<std::array<StateMask, orientationCount>, 8> &GetStateMasks()
+		{
+			static const std::array<std::array<StateMask, orientationCount>, 8> stateMasks = []() -> std::array<std::array<StateMask, orientationCount>, 8>
+			{
+				std::array<std::array<StateMask, orientationCount>, 8> result = std::array<std::array<StateMask, orientationCount>, 8>();
+
+				for (usize shape = 1; shape < result.size(); ++shape)
+				{
+					for (int orientation = 0; orientation < orientationCount; ++orientation)
+					{
+						const TetrominoState &state = PieceShape::GetAll()[shape].states[orientation];
+						StateMask &stateMask = result[shape][static_cast<usize>(orientation)];
+						stateMask.mins = int2 { std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
+						stateMask.maxes = int2 { std::numeric_limits<int>::min(), std::numeric_limits<int>::min() };
+
+						for (int2 cell : state)
+						{
+							stateMask.mins = int2 { std::min(stateMask.mins.x, cell.x), std::min(stateMask.mins.y, cell.y) };
+							stateMask.maxes = int2 { std::max(stateMask.maxes.x, cell.x), std::max(stateMask.maxes.y, cell.y) };
+						}
+
+						for (int2 cell : state)
+						{
+							stateMask.mask |= static_cast<std::uint64_t>(1) << ((cell.y - stateMask.mins.y) * Width + cell.x - stateMask.mins.x);
+						}
+					}
+				}
+
+				return result;
+			}();
+
+			return stateMasks;
+		}
+
+		static constexpr std::uint64_t GetMask(const StateMask &stateMask, int2 offset) noexcept
+		{
+			return ShiftUp(stateMask.mask, (offset.y + stateMask.mins.y) * Width + offset.x + stateMask.mins.x);
+		}
+
+		// Rows at or above the field's lines are empty, the board has to be for a perfect clear within them.
+		static constexpr bool Fits(std::uint64_t field, const StateMask &stateMask, int2 offset) noexcept
+		{
+			return offset.x + stateMask.mins.x >= 0 && offset.x + stateMask.maxes.x < Width && offset.y + stateMask.mins.y >= 0 &&
+				(field & GetMask(stateMask, offset)) == 0;
+		}
+
+		// Every distinct resting place of the piece reachable by moving, soft dropping and rotating (with kicks) from the open rows
+		// above the field, each with the first way found to get there.
+		static void GeneratePlacements(std::uint64_t field, int lines, usize shapeIndex, bool hold, std::vector<Landing> &result)
+		{
+			const PieceShape &shape = PieceShape::GetAll()[shapeIndex];
+			const std::array<StateMask, orientationCount> &stateMasks = GetStateMasks()[shapeIndex];
+			std::array<bool, stateCount> visited = std::array<bool, stateCount>();
+			std::array<std::pair<int, int2>, stateCount> queue;
+			usize head = 0;
+			usize tail = 0;
+			result.clear();
+
+			auto visit = [&](int orientation, int2 offset) -> void
+			{
+				if (offset.x < -offsetPadding || offset.x >= Width || offset.y < -offsetPadding || offset.y + stateMasks[static_cast<usize>(orientation)].mins.y > lines)
+				{
+					return; // out there the piece is either in a wall or higher up in the open, which the seeds already stand for
+				}
+
+				usize index = GetStateIndex(orientation, offset);
+
+				if (!visited[index] && Fits(field, stateMasks[static_cast<usize>(orientation)], offset))
+				{
+					visited[index] = true;
+					queue[tail] = { orientation, offset };
+					++tail;
+				}
+			};
+
+			// anything that fits between the walls can be reached in the empty rows above the field
+			for (int orientation = 0; orientation < orientationCount; ++orientation)
+			{
+				for (int x = -offsetPadding; x < Width; ++x)
+				{
+					visit(orientation, int2 { x, lines - stateMasks[static_cast<usize>(orientation)].mins.y });
+				}
+			}
+
+			while (head < tail)
+			{
+				auto [orientation, offset] = queue[head];
+				const StateMask &stateMask = stateMasks[static_cast<usize>(orientation)];
+				++head;
+
+				visit(orientation, offset + int2 { -1, 0 });
+				visit(orientation, offset + int2 { 1, 0 });
+
+				for (usize direction = 0; direction < PieceShape::rotateDirectionCount; ++direction)
+				{
+					int newOrientation = static_cast<int>(RotateOrientation(static_cast<Orientation>(orientation), PieceShape::rotateDirections[direction]));
+
+					for (usize i = 0; i < shape.kickCounts[orientation][direction]; ++i)
+					{
+						int2 kickedOffset = offset + shape.kicks[orientation][direction][i];
+
+						if (Fits(field, stateMasks[static_cast<usize>(newOrientation)], kickedOffset))
+						{
+							visit(newOrientation, kickedOffset);
+							break;
+						}
+					}
+				}
+
+				if (Fits(field, stateMask, offset + int2 { 0, -1 }))
+				{
+					visit(orientation, offset + int2 { 0, -1 });
+					continue;
+				}
+
+				std::uint64_t mask = GetMask(stateMask, offset);
+
+				if (offset.y + stateMask.maxes.y < lines &&
+					std::none_of(result.begin(), result.end(), [mask](const Landing &landing) -> bool { return landing.mask == mask; }))
+				{
+					result.push_back(Landing { Placement { offset, static_cast<Orientation>(orientation), hold }, mask });
+				}
+			}
+		}
+
+		// Locks the piece in and removes the rows it fills.
+		static void Place(std::uint64_t &field, int &lines, std::uint64_t mask) noexcept
+		{
+			field |= mask;
+
+			for (int row = lines - 1; row >= 0; --row)
+			{
+				if (((field >> (row * Width)) & fullRow) == fullRow)
+				{
+					field = (field & LowBits(row * Width)) | (ShiftDown(field, (row + 1) * Width) << (row * Width));
+					--lines;
+				}
+			}
+		}
+
+		// Whether the pieces can have a column imbalance (empty cells in even minus odd columns) of exactly imbalance.
+		// J, L and vertical T fill 3 cells of one parity and 1 of the other, a vertical I 4 of one, the rest 2 and 2.
+		static bool CanBalance(int imbalance, int jlCount, int tCount, int iCount) noexcept
+		{
+			if (imbalance % 2 != 0)
+			{
+				return false;
+			}
+
+			int half = Abs(imbalance / 2);
+			return half <= jlCount + tCount + iCount * 2 && (tCount > 0 || (half - jlCount) % 2 == 0);
+		}
+
+		// needed is at most a full field worth of pieces, plus the one that can go to the hold
+		static constexpr usize maxBalanceCandidates = static_cast<usize>(maxLines * Width / 4) + 1;
+
+		bool CanBalance(int imbalance, usize next, usize held, usize needed) const noexcept
+		{
+			std::array<usize, maxBalanceCandidates> candidates = std::array<usize, maxBalanceCandidates>();
+			usize candidateCount = 0;
+
+			if (held != 0)
+			{
+				candidates[candidateCount] = held;
+				++candidateCount;
+			}
+
+			for (usize i = next; i < pieces.size() && candidateCount < needed + 1; ++i)
+			{
+				candidates[candidateCount] = pieces[i];
+				++candidateCount;
+			}
+
+			// whichever piece is left over ends up in the hold, and it can be any of them
+			for (usize excluded = 0; excluded < candidateCount; ++excluded)
+			{
+				if (candidateCount == needed && excluded > 0)
+				{
+					break;
+				}
+
+				int counts[8] = {};
+
+				for (usize i = 0; i < candidateCount; ++i)
+				{
+					if (i != excluded || candidateCount == needed)
+					{
+						++counts[candidates[i]];
+					}
+				}
+
+				int jlCount = counts[GetTetrominoIndex(TetrominoType::J)] + counts[GetTetrominoIndex(TetrominoType::L)];
+
+				if (CanBalance(imbalance, jlCount, counts[GetTetrominoIndex(TetrominoType::T)], counts[GetTetrominoIndex(TetrominoType::I)]))
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		static constexpr std::uint64_t GetLeftColumn() noexcept
+		{
+			std::uint64_t result = 0;
+
+			for (int row = 0; row < maxLines; ++row)
+			{
+				result |= static_cast<std::uint64_t>(1) << (row * Width);
+			}
+
+			return result;
+		}
+
+		// Spreads cells by one to each side, without wrapping around rows, and keeps what's inside within.
+		static constexpr std::uint64_t Grow(std::uint64_t cells, std::uint64_t within) noexcept
+		{
+			constexpr std::uint64_t leftColumn = GetLeftColumn();
+			constexpr std::uint64_t rightColumn = leftColumn << (Width - 1);
+			return (cells | ((cells & ~rightColumn) << 1) | ((cells & ~leftColumn) >> 1) | (cells << Width) | (cells >> Width)) & within;
+		}
+
+		// Empty cells that can't be reached from the rows above the field without a line clear first.
+		static std::uint64_t GetSealedCells(std::uint64_t field, int lines) noexcept
+		{
+			std::uint64_t empty = ~field & LowBits(lines * Width);
+			std::uint64_t open = empty & (fullRow << ((lines - 1) * Width));
+
+			for (std::uint64_t grown = Grow(open, empty); grown != open; grown = Grow(open, empty))
+			{
+				open = grown;
+			}
+
+			return empty & ~open;
+		}
+
+		// A sealed hole smaller than a piece can't be filled before the row right above or below it clears, and none of its own rows
+		// can clear before it's filled. So if every way out goes through rows stuck the same way, the holes are there for good.
+		static bool HasStuckHoles(std::uint64_t field, int lines) noexcept
+		{
+			std::uint64_t sealed = GetSealedCells(field, lines);
+			std::array<std::pair<int, int>, 64> holes; // lowest and highest row of each
+			usize holeCount = 0;
+			std::uint64_t stuckRows = 0;
+
+			while (sealed != 0)
+			{
+				std::uint64_t hole = sealed & (~sealed + 1);
+
+				for (std::uint64_t grown = Grow(hole, sealed); grown != hole; grown = Grow(hole, sealed))
+				{
+					hole = grown;
+				}
+
+				sealed &= ~hole;
+
+				if (std::popcount(hole) < 4)
+				{
+					int lowestRow = std::countr_zero(hole) / Width;
+					int highestRow = (63 - std::countl_zero(hole)) / Width;
+					holes[holeCount] = { lowestRow, highestRow };
+					++holeCount;
+					stuckRows |= LowBits(highestRow + 1) & ~LowBits(lowestRow);
+				}
+			}
+
+			bool changed = true;
+
+			while (changed && holeCount > 0)
+			{
+				changed = false;
+
+				for (usize i = 0; i < holeCount; ++i)
+				{
+					auto [lowestRow, highestRow] = holes[i];
+					bool belowFree = lowestRow > 0 && ((stuckRows >> (lowestRow - 1)) & 1) == 0;
+					bool aboveFree = highestRow + 1 < lines && ((stuckRows >> (highestRow + 1)) & 1) == 0;
+
+					if (belowFree || aboveFree)
+					{
+						holes[i] = holes[holeCount - 1];
+						--holeCount;
+						changed = true;
+						stuckRows = 0;
+
+						for (usize j = 0; j < holeCount; ++j)
+						{
+							stuckRows |= LowBits(holes[j].second + 1) & ~LowBits(holes[j].first);
+						}
+
+						break;
+					}
+				}
+			}
+
+			return holeCount > 0;
+		}
+
+		bool IsDeadEnd(std::uint64_t field, int lines, usize next, usize held) const noexcept
+		{
+			int emptyCount = Width * lines - std::popcount(field);
+
+			if (emptyCount % 4 != 0)
+			{
+				return true;
+			}
+
+			usize needed = static_cast<usize>(emptyCount / 4);
+			usize available = pieces.size() - next + (held != 0 ? 1 : 0);
+
+			if (needed > available)
+			{
+				return true;
+			}
+
+			// a filled column splits the field, and no piece fits across it
+			int sideCount = 0;
+			int imbalance = 0;
+
+			for (int column = 0; column < Width; ++column)
+			{
+				int columnEmptyCount = 0;
+
+				for (int row = 0; row < lines; ++row)
+				{
+					columnEmptyCount += static_cast<int>(((field >> (row * Width + column)) & 1) == 0);
+				}
+
+				if (columnEmptyCount == 0 && sideCount % 4 != 0)
+				{
+					return true;
+				}
+
+				sideCount = columnEmptyCount == 0 ? 0 : sideCount + columnEmptyCount;
+				imbalance += column % 2 == 0 ? columnEmptyCount : -columnEmptyCount;
+			}
+
+			if (sideCount % 4 != 0 || !CanBalance(imbalance, next, held, needed))
+			{
+				return true;
+			}
+
+			return HasStuckHoles(field, lines);
+		}
+
+		std::uint64_t GetKey(std::uint64_t field, int lines, usize next, usize held) const noexcept
+		{
+			return Mix(field) ^ Mix(queueKeys[next] + static_cast<std::uint64_t>(held) * 64 + static_cast<std::uint64_t>(lines));
+		}
+
+		// The current piece is pieces[next], or the next one after it if the hold is still empty and gets pressed.
+		usize GetOptions(usize next, usize held, std::array<Option, 2> &options) const noexcept
+		{
+			usize count = 0;
+
+			if (next < pieces.size())
+			{
+				options[count] = Option { pieces[next], next + 1, held, false };
+				++count;
+
+				if (held != 0 && held != pieces[next])
+				{
+					options[count] = Option { held, next + 1, pieces[next], true };
+					++count;
+				}
+				else if (held == 0 && next + 1 < pieces.size() && pieces[next + 1] != pieces[next])
+				{
+					options[count] = Option { pieces[next + 1], next + 2, pieces[next], true };
+					++count;
+				}
+			}
+			else if (held != 0)
+			{
+				options[count] = Option { held, next, 0, true }; // the queue ran out, the board would take the next piece from the bag
+				++count;
+			}
+
+			return count;
+		}
+
+		SearchResult Search(std::uint64_t field, int lines, usize next, usize held, SearchContext &context) const
+		{
+			if (solvedRootIndex.load(std::memory_order_relaxed) < context.rootIndex)
+			{
+				return SearchResult::Aborted; // an earlier first placement already worked out
+			}
+
+			if (IsDeadEnd(field, lines, next, held))
+			{
+				return SearchResult::NotFound;
+			}
+
+			std::uint64_t key = GetKey(field, lines, next, held);
+			TranspositionEntry entry = TranspositionEntry();
+
+			if (table->Probe(key, entry))
+			{
+				return SearchResult::NotFound; // only dead ends get stored
+			}
+
+			usize depth = context.path.size();
+
+			if (context.landings.size() <= depth)
+			{
+				context.landings.resize(depth + 1);
+			}
+
+			std::array<Option, 2> options;
+			usize optionCount = GetOptions(next, held, options);
+
+			for (usize i = 0; i < optionCount; ++i)
+			{
+				const Option &option = options[i];
+				GeneratePlacements(field, lines, option.shapeIndex, option.hold, context.landings[depth]);
+
+				for (const Landing &landing : context.landings[depth])
+				{
+					std::uint64_t newField = field;
+					int newLines = lines;
+					Place(newField, newLines, landing.mask);
+					context.path.Add(landing.placement);
+
+					if (newField == 0)
+					{
+						return SearchResult::Found;
+					}
+
+					SearchResult result = Search(newField, newLines, option.next, option.held, context);
+
+					if (result != SearchResult::NotFound)
+					{
+						return result;
+					}
+
+					context.path.RemoveLast();
+				}
+			}
+
+			table->Store(key, 0.0f, Placement::None(), static_cast<int>(pieces.size() - next));
+			return SearchResult::NotFound;
+		}
+
+		// A task runs to the end on the thread that took it, so each thread only ever has one context in use at a time
+		SearchContext &GetContext() noexcept
+		{
+			usize worker = scheduler->GetCurrentWorkerIndex();
+			return contexts[worker != Threading::noAffinity ? worker : contexts.size() - 1];
+		}
+
+		Nullable<PlacementList> SearchLines(std::uint64_t field, int lines, usize held)
+		{
+			struct Child final
+			{
+			public:
+				Landing landing;
+				Option option;
+				std::uint64_t field;
+				int lines;
+			};
+
+			std::vector<Child> children = std::vector<Child>();
+			std::vector<Landing> landings = std::vector<Landing>();
+			std::array<Option, 2> options;
+			usize optionCount = GetOptions(0, held, options);
+
+			for (usize i = 0; i < optionCount; ++i)
+			{
+				GeneratePlacements(field, lines, options[i].shapeIndex, options[i].hold, landings);
+
+				for (const Landing &landing : landings)
+				{
+					Child child = Child { landing, options[i], field, lines };
+					Place(child.field, child.lines, landing.mask);
+
+					if (child.field == 0)
+					{
+						return PlacementList { landing.placement };
+					}
+
+					children.push_back(child);
+				}
+			}
+
+			// the first child in order (not the fastest) that works out wins, and only children after a solved one give up early,
+			// so results don't depend on timing
+			std::vector<PlacementList> solutions = std::vector<PlacementList>(children.size());
+			solvedRootIndex.store(std::numeric_limits<usize>::max(), std::memory_order_relaxed);
+
+			Threading::ParallelFor(*scheduler, 0, children.size(), [&](usize i) -> void
+			{
+				const Child &child = children[i];
+				SearchContext &context = GetContext();
+				context.rootIndex = i;
+				context.path.Clear();
+				context.path.Add(child.landing.placement);
+
+				if (Search(child.field, child.lines, child.option.next, child.option.held, context) == SearchResult::Found)
+				{
+					solutions[i] = context.path;
+					usize solved = solvedRootIndex.load(std::memory_order_relaxed);
+
+					while (i < solved && !solvedRootIndex.compare_exchange_weak(solved, i, std::memory_order_relaxed)) {}
+				}
+			});
+
+			usize solved = solvedRootIndex.load(std::memory_order_relaxed);
+			return solved < children.size() ? Nullable<PlacementList>(std::move(solutions[solved])) : Nullable<PlacementList>();
+		}
+
+	public:
+		/// @param scheduler Where the root children are searched, one with no workers keeps it all on the calling thread
+		explicit PerfectClearFinder(TranspositionTable &table, Scheduler &scheduler = Scheduler::GetShared()) : table(std::addressof(table)),
+			scheduler(std::addressof(scheduler)), contexts(scheduler.GetConcurrency()), pieces(), queueKeys(), solvedRootIndex(0) {}
+
+		/// @param rows The bottom rows of the board, bit i of a row being column i
+		/// @param queue The current piece followed by the next queue
+		/// @return The placements in order, each of them from the piece's spawn and after any earlier line clears; null if there are none
+		Nullable<PlacementList> Find(std::span<const std::uint64_t> rows, std::span<const TetrominoType> queue, TetrominoType held, int lineLimit)
+		{
+			std::uint64_t field = 0;
+			int lowestLines = 1;
+
+			for (usize row = 0; row < rows.size(); ++row)
+			{
+				if (rows[row] != 0)
+				{
+					if (row >= static_cast<usize>(maxLines))
+					{
+						return Nullable<PlacementList>();
+					}
+
+					field |= (rows[row] & fullRow) << (row * Width);
+					lowestLines = static_cast<int>(row) + 1;
+				}
+			}
+
+			pieces.clear();
+
+			for (TetrominoType tetrominoType : queue)
+			{
+				pieces.push_back(GetTetrominoIndex(tetrominoType));
+			}
+
+			queueKeys.assign(pieces.size() + 1, 0);
+
+			for (usize i = pieces.size(); i-- > 0;)
+			{
+				queueKeys[i] = Mix(queueKeys[i + 1] * 8 + pieces[i]);
+			}
+
+			for (int lines = lowestLines; lines <= std::min(lineLimit, maxLines); ++lines)
+			{
+				if (!IsDeadEnd(field, lines, 0, GetTetrominoIndex(held)))
+				{
+					Nullable<PlacementList> result = SearchLines(field, lines, GetTetrominoIndex(held));
+
+					if (result.HasValue())
+					{
+						return result;
+					}
+				}
+			}
+
+			return Nullable<PlacementList>();
+		}
+
+		template <const int Height>
+		Nullable<PlacementList> Find(const BasicBoard<Width, Height> &board, int lineLimit)
+		{
+			std::array<std::uint64_t, Height> rows = std::array<std::uint64_t, Height>();
+			std::copy(board.GetRowMasks().begin(), board.GetRowMasks().end(), rows.begin());
+
+			std::vector<TetrominoType> queue = std::vector<TetrominoType> { board.GetTetrominoType() };
+
+			for (const Tetromino &tetromino : board.GetNextQueue())
+			{
+				queue.push_back(tetromino.tetrominoType);
+			}
+
+			const Tetromino *held = board.GetHoldQueue().TryGet();
+			return Find(rows, queue, held != nullptr ? held->tetrominoType : TetrominoType::None, lineLimit);
+		}
+	};
+
+	/// @brief Does a placement on the board: holds first if it says so, puts the piece where it says and locks it.
+	/// @return False, leaving the board as it was apart from the hold, if the piece doesn't fit there
+	template <const int Width, const int Height>
+	bool ApplyPlacement(BasicBoard<Width, Height> &board, const Placement &placement)
+	{
+		if (placement.hold)
+		{
+			board.HoldPiece();
+		}
+
+		const PieceShape &shape = PieceShape::GetAll()[GetTetrominoIndex(board.GetTetrominoType())];
+
+		if (!board.SetPieceState(shape.states[static_cast<usize>(placement.orientation)] + placement.offset, placement.orientation))
+		{
+			return false;
+		}
+
+		board.HardDropPiece();
+		return true;
+	}
+
+	// The pieces the bag in progress still has to hand out, per GetTetrominoIndex(). Each comes next with probability count / total,
+	// and an empty bag is a full one again.
+	struct BagState final
+	{
+	public:
+		static constexpr usize bagSize = 7;
+
+		std::array<int, 8> counts;
+		int total;
+
+		static constexpr BagState Full() noexcept
+		{
+			return BagState { { 0, 1, 1, 1, 1, 1, 1, 1 }, static_cast<int>(bagSize) };
+		}
+
+		constexpr float GetProbability(usize tetrominoIndex) const noexcept
+		{
+			return static_cast<float>(counts[tetrominoIndex]) / static_cast<float>(total);
+		}
+
+		constexpr BagState Draw(usize tetrominoIndex) const noexcept
+		{
+			if (total <= 1)
+			{
+				return Full();
+			}
+
+			BagState result = *this;
+			--result.counts[tetrominoIndex];
+			--result.total;
+			return result;
+		}
+
+		// 3 bits per piece type, for hash keys
+		constexpr std::uint64_t Pack() const noexcept
+		{
+			std::uint64_t result = 0;
+
+			for (usize i = 1; i < counts.size(); ++i)
+			{
+				result |= static_cast<std::uint64_t>(counts[i]) << (i * 3);
+			}
+
+			return result;
+		}
+
+		/// @brief What a player who sees only the first previewCount pieces of the next queue knows about the pieces after them.
+		/// The hidden ones in the queue were drawn from the same bags, so they count as unseen along with the rest of their bag.
+		template <const int Width, const int Height>
+		static BagState FromBoard(const BasicBoard<Width, Height> &board, usize previewCount)
+		{
+			BagState result = BagState { board.GetBagRemainderCounts(), 0 };
+			usize queueSize = board.GetNextSize();
+			usize drawn = board.GetBagIndex(); // the last ones in the queue came from the current bag
+			usize firstCurrent = queueSize - std::min(drawn, queueSize);
+			usize firstHidden = std::min(previewCount, queueSize);
+
+			if (firstHidden < firstCurrent)
+			{
+				result.counts = std::array<int, 8>(); // the first hidden piece is from the previous bag, only its tail is left of it
+			}
+
+			usize index = 0;
+
+			for (const Tetromino &tetromino : board.GetNextQueue())
+			{
+				if (index >= firstHidden && (index >= firstCurrent) == (firstHidden >= firstCurrent))
+				{
+					++result.counts[GetTetrominoIndex(tetromino.tetrominoType)];
+				}
+
+				++index;
+			}
+
+			for (usize i = 1; i < result.counts.size(); ++i)
+			{
+				result.total += result.counts[i];
+			}
+
+			return result.total > 0 ? result : Full();
+		}
+	};
+
+	struct EvaluationWeights final
+	{
+	public:
+		float aggregateHeight;
+		float maxHeight;
+		float holes;
+		float bumpiness;
+		float wellDepth; // of the deepest well, which is where I pieces go
+		float lineClears[5]; // by lines cleared at once
+		float perfectClear;
+
+		static const EvaluationWeights defaultWeights;
+	};
+
+	constexpr inline EvaluationWeights EvaluationWeights::defaultWeights =
+	{
+		-0.5f, -0.3f, -4.0f, -0.25f, 0.3f, { 0.0f, -1.0f, -0.5f, 0.0f, 8.0f }, 30.0f
+	};
+
+	/// @brief Picks placements by searching a few pieces ahead. Pieces the player can't see yet are chance nodes over what's left
+	/// in the bag, weighted by how many of each are left, rather than over all 7 types. Every node scores all of its placements
+	/// in one batch, then only searches the best beamWidth of them deeper; the root's are searched on separate threads.
+	template <const int Width, const int Height>
+	class ExpectimaxPlayer final
+	{
+	public:
+		using RowMask = typename BasicBoard<Width, Height>::RowMask;
+		using Rows = std::array<RowMask, Height>;
+
+		static constexpr float lostScore = -1.0e9f;
+
+	private:
+		static constexpr RowMask fullRowMask = BasicBoard<Width, Height>::fullRowMask;
+		static constexpr int offsetPadding = 3;
+		static constexpr int offsetColumns = Width + offsetPadding;
+		static constexpr int offsetRows = Height + offsetPadding;
+		static constexpr usize stateCount = static_cast<usize>(orientationCount * offsetColumns * offsetRows);
+
+		// A piece state as one row mask per row it covers, anchored at its lowest and leftmost cells.
+		struct StateRows final
+		{
+		public:
+			RowMask rows[4];
+			int2 mins;
+			int2 maxes;
+		};
+
+		struct Node final
+		{
+		public:
+			Rows rows;
+			std::uint64_t rowsKey; // XOR of GetRowKey() over the rows, kept up to date as pieces are placed
+			usize next;
+			usize held;
+			BagState bag;
+		};
+
+		struct Child final
+		{
+		public:
+			Placement placement;
+			Node node;
+			float reward;
+			float score; // reward plus the evaluation of the board, for picking the ones worth a deeper look
+		};
+
+		// Per thread, one list of children per depth, reused from search to search.
+		struct SearchContext final
+		{
+		public:
+			std::vector<std::vector<Child>> children;
+			std::vector<std::uint64_t> landingKeys;
+		};
+
+		TranspositionTable *table;
+		EvaluationWeights weights;
+		int depth;
+		usize beamWidth;
+		usize previewCount;
+		Scheduler *scheduler;
+		std::vector<SearchContext> contexts; // one per worker of the scheduler, the last one for the thread calling Choose()
+		std::vector<usize> pieces; // GetTetrominoIndex() of the current piece and the visible part of the next queue
+		std::vector<std::uint64_t> queueKeys; // queueKeys[i] stands for pieces[i..], since next is only an index into this call's pieces
+
+		static const std::array<std::array<StateRows, orientationCount>, 8> &GetStateRows()
+		{
+			static const std::array<std::array<StateRows, orientationCount>, 8> stateRows = []() -> std::array<std::array<StateRows, orientationCount>, 8>
+			{
+				std::array<std::array<StateRows, orientationCount>, 8> result = std::array<std::array<StateRows, orientationCount>, 8>();
+
+				for (usize shape = 1; shape < result.size(); ++shape)
+				{
+					for (int orientation = 0; orientation < orientationCount; ++orientation)
+					{
+						const TetrominoState &state = PieceShape::GetAll()[shape].states[orientation];
+						StateRows &current = result[shape][static_cast<usize>(orientation)];
+						current.mins = int2 { std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
+						current.maxes = int2 { std::numeric_limits<int>::min(), std::numeric_limits<int>::min() };
+
+						for (int2 cell : state)
+						{
+							current.mins = int2 { std::min(current.mins.x, cell.x), std::min(current.mins.y, cell.y) };
+							current.maxes = int2 { std::max(current.maxes.x, cell.x), std::max(current.maxes.y, cell.y) };
+						}
+
+						for (int2 cell : state)
+						{
+							current.rows[cell.y - current.mins.y] |= static_cast<RowMask>(static_cast<RowMask>(1) << (cell.x - current.mins.x));
+						}
+					}
+				}
+
+				return result;
+			}();
+
+			return stateRows;
+		}
+
+		static bool Fits(const Rows &rows, const StateRows &stateRows, int2 offset) noexcept
+		{
+			int left = offset.x + stateRows.mins.x;
+			int bottom = offset.y + stateRows.mins.y;
+
+			if (left < 0 || offset.x + stateRows.maxes.x >= Width || bottom < 0 || offset.y + stateRows.maxes.y >= Height)
+			{
+				return false;
+			}
+
+			for (int row = 0; row <= stateRows.maxes.y - stateRows.mins.y; ++row)
+			{
+				if ((rows[static_cast<usize>(bottom + row)] & static_cast<RowMask>(stateRows.rows[row] << left)) != 0)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		static int GetStackHeight(const Rows &rows) noexcept
+		{
+			int result = Height;
+
+			while (result > 0 && rows[static_cast<usize>(result - 1)] == 0)
+			{
+				--result;
+			}
+
+			return result;
+		}
+
+		// Random odd multipliers, one per row. GetKey() mixes the combined rows afterwards, so placing a piece costs a multiply per changed row.
+		static constexpr std::array<std::uint64_t, Height> rowKeyMultipliers = []() -> std::array<std::uint64_t, Height>
+		{
+			std::array<std::uint64_t, Height> result = std::array<std::uint64_t, Height>();
+			std::uint64_t seed = 0x5ea4c4;
+
+			for (std::uint64_t &multiplier : result)
+			{
+				multiplier = Randomizers::SplitMix64(seed) | 1;
+			}
+
+			return result;
+		}();
+
+		// Empty rows count for nothing, so the rows above the stack never need hashing
+		static constexpr std::uint64_t GetRowKey(int row, RowMask rowMask) noexcept
+		{
+			return static_cast<std::uint64_t>(rowMask) * rowKeyMultipliers[static_cast<usize>(row)];
+		}
+
+		static std::uint64_t GetRowsKey(const Rows &rows) noexcept
+		{
+			std::uint64_t result = 0;
+
+			for (int row = 0; row < Height; ++row)
+			{
+				result ^= GetRowKey(row, rows[static_cast<usize>(row)]);
+			}
+
+			return result;
+		}
+
+		// Locks the piece in, removes the rows it fills and returns how many that was. Only the rows that change are rehashed.
+		static int Place(Rows &rows, std::uint64_t &rowsKey, const StateRows &stateRows, int2 offset) noexcept
+		{
+			int left = offset.x + stateRows.mins.x;
+			int bottom = offset.y + stateRows.mins.y;
+			int top = offset.y + stateRows.maxes.y;
+
+			for (int row = bottom; row <= top; ++row)
+			{
+				RowMask &rowMask = rows[static_cast<usize>(row)];
+				rowsKey ^= GetRowKey(row, rowMask);
+				rowMask |= static_cast<RowMask>(stateRows.rows[row - bottom] << left);
+				rowsKey ^= GetRowKey(row, rowMask);
+			}
+
+			int cleared = 0;
+
+			for (int row = bottom; row < Height; ++row)
+			{
+				RowMask rowMask = rows[static_cast<usize>(row)];
+
+				if (row <= top && rowMask == fullRowMask)
+				{
+					rowsKey ^= GetRowKey(row, rowMask);
+					++cleared;
+				}
+				else if (cleared > 0)
+				{
+					rowsKey ^= GetRowKey(row, rowMask) ^ GetRowKey(row - cleared, rowMask);
+					rows[static_cast<usize>(row - cleared)] = rowMask;
+				}
+			}
+
+			std::fill(rows.end() - cleared, rows.end(), static_cast<RowMask>(0));
+			return cleared;
+		}
+
+		// Adds every distinct resting place of the piece to children, the same way PerfectClearFinder finds them, but over the whole board.
+		void GenerateChildren(const Node &node, usize shapeIndex, usize next, usize held, bool hold, const BagState &bag,
+			std::vector<Child> &children, std::vector<std::uint64_t> &landingKeys) const
+		{
+			const PieceShape &shape = PieceShape::GetAll()[shapeIndex];
+			const std::array<StateRows, orientationCount> &stateRows = GetStateRows()[shapeIndex];
+			int stackHeight = GetStackHeight(node.rows);
+			std::array<bool, stateCount> visited = std::array<bool, stateCount>();
+			std::array<std::pair<int, int2>, stateCount> queue;
+			usize head = 0;
+			usize tail = 0;
+			landingKeys.clear();
+
+			auto visit = [&](int orientation, int2 offset) -> void
+			{
+				if (offset.x < -offsetPadding || offset.x >= Width || offset.y < -offsetPadding ||
+					offset.y + stateRows[static_cast<usize>(orientation)].mins.y > stackHeight)
+				{
+					return;
+				}
+
+				usize index = static_cast<usize>((orientation * offsetColumns + offset.x + offsetPadding) * offsetRows + offset.y + offsetPadding);
+
+				if (!visited[index] && Fits(node.rows, stateRows[static_cast<usize>(orientation)], offset))
+				{
+					visited[index] = true;
+					queue[tail] = { orientation, offset };
+					++tail;
+				}
+			};
+
+			for (int orientation = 0; orientation < orientationCount; ++orientation)
+			{
+				for (int x = -offsetPadding; x < Width; ++x)
+				{
+					visit(orientation, int2 { x, stackHeight - stateRows[static_cast<usize>(orientation)].mins.y });
+				}
+			}
+
+			while (head < tail)
+			{
+				auto [orientation, offset] = queue[head];
+				const StateRows &current = stateRows[static_cast<usize>(orientation)];
+				++head;
+
+				visit(orientation, offset + int2 { -1, 0 });
+				visit(orientation, offset + int2 { 1, 0 });
+
+				for (usize direction = 0; direction < PieceShape::rotateDirectionCount; ++direction)
+				{
+					int newOrientation = static_cast<int>(RotateOrientation(static_cast<Orientation>(orientation), PieceShape::rotateDirections[direction]));
+
+					for (usize i = 0; i < shape.kickCounts[orientation][direction]; ++i)
+					{
+						int2 kickedOffset = offset + shape.kicks[orientation][direction][i];
+
+						if (Fits(node.rows, stateRows[static_cast<usize>(newOrientation)], kickedOffset))
+						{
+							visit(newOrientation, kickedOffset);
+							break;
+						}
+					}
+				}
+
+				if (Fits(node.rows, current, offset + int2 { 0, -1 }))
+				{
+					visit(orientation, offset + int2 { 0, -1 });
+					continue;
+				}
+
+				// the same cells from another orientation (O, I, S and Z have some) are the same placement
+				std::uint64_t landingKey = static_cast<std::uint64_t>(offset.y + current.mins.y) << 48 | static_cast<std::uint64_t>(offset.x + current.mins.x) << 40;
+
+				for (int row = 0; row <= current.maxes.y - current.mins.y; ++row)
+				{
+					landingKey |= static_cast<std::uint64_t>(current.rows[row]) << (row * 4);
+				}
+
+				if (std::find(landingKeys.begin(), landingKeys.end(), landingKey) != landingKeys.end())
+				{
+					continue;
+				}
+
+				landingKeys.push_back(landingKey);
+				Child child = Child { Placement { offset, static_cast<Orientation>(orientation), hold }, node, 0.0f, 0.0f };
+				child.node.next = next;
+				child.node.held = held;
+				child.node.bag = bag;
+				int cleared = Place(child.node.rows, child.node.rowsKey, current, offset);
+				child.reward = weights.lineClears[std::min(cleared, 4)] + (cleared > 0 && child.node.rows[0] == 0 ? weights.perfectClear : 0.0f);
+				children.push_back(child);
+			}
+		}
+
+		float Evaluate(const Rows &rows) const noexcept
+		{
+			int heights[Width] = {};
+			RowMask seen = 0;
+			int filledCount = 0;
+
+			for (int row = Height - 1; row >= 0; --row)
+			{
+				RowMask rowMask = rows[static_cast<usize>(row)];
+				filledCount += std::popcount(static_cast<std::uint64_t>(rowMask));
+
+				for (RowMask newColumns = static_cast<RowMask>(rowMask & ~seen); newColumns != 0; newColumns &= static_cast<RowMask>(newColumns - 1))
+				{
+					heights[std::countr_zero(static_cast<std::uint64_t>(newColumns))] = row + 1;
+				}
+
+				seen |= rowMask;
+			}
+
+			int aggregateHeight = 0;
+			int maxHeight = 0;
+			int bumpiness = 0;
+			int wellDepth = 0;
+
+			for (int column = 0; column < Width; ++column)
+			{
+				aggregateHeight += heights[column];
+				maxHeight = std::max(maxHeight, heights[column]);
+
+				if (column + 1 < Width)
+				{
+					bumpiness += Abs(heights[column] - heights[column + 1]);
+				}
+
+				int left = column > 0 ? heights[column - 1] : Height;
+				int right = column + 1 < Width ? heights[column + 1] : Height;
+				wellDepth = std::max(wellDepth, std::min(left, right) - heights[column]);
+			}
+
+			return weights.aggregateHeight * static_cast<float>(aggregateHeight) + weights.maxHeight * static_cast<float>(maxHeight) +
+				weights.holes * static_cast<float>(aggregateHeight - filledCount) + weights.bumpiness * static_cast<float>(bumpiness) +
+				weights.wellDepth * static_cast<float>(std::min(wellDepth, 4));
+		}
+
+		// One pass over the whole batch, so the boards are still in cache from generating them.
+		void EvaluateBatch(std::vector<Child> &children) const noexcept
+		{
+			for (Child &child : children)
+			{
+				child.score = child.reward + Evaluate(child.node.rows);
+			}
+		}
+
+		std::uint64_t GetKey(const Node &node, int remainingDepth) const noexcept
+		{
+			std::uint64_t state = node.rowsKey ^ queueKeys[node.next] ^ (static_cast<std::uint64_t>(node.next) | static_cast<std::uint64_t>(node.held) << 8 |
+				static_cast<std::uint64_t>(remainingDepth) << 12 | node.bag.Pack() << 20);
+			return Randomizers::SplitMix64(state);
+		}
+
+		// The children of a node whose current piece is known, with and without pressing hold.
+		void GenerateKnownChildren(const Node &node, std::vector<Child> &children, std::vector<std::uint64_t> &landingKeys) const
+		{
+			usize current = pieces[node.next];
+			children.clear();
+			GenerateChildren(node, current, node.next + 1, node.held, false, node.bag, children, landingKeys);
+
+			if (node.held != 0 && node.held != current)
+			{
+				GenerateChildren(node, node.held, node.next + 1, current, true, node.bag, children, landingKeys);
+			}
+			else if (node.held == 0 && node.next + 1 < pieces.size() && pieces[node.next + 1] != current)
+			{
+				GenerateChildren(node, pieces[node.next + 1], node.next + 2, current, true, node.bag, children, landingKeys);
+			}
+		}
+
+		// Best of the children: straight from the batch at the last depth, otherwise from searching the best few deeper.
+		float SearchChildren(usize childDepth, int remainingDepth, SearchContext &context) const
+		{
+			std::vector<Child> &children = context.children[childDepth];
+
+			if (children.empty())
+			{
+				return lostScore;
+			}
+
+			EvaluateBatch(children);
+			usize expanded = std::min(beamWidth, children.size());
+			std::partial_sort(children.begin(), children.begin() + static_cast<std::ptrdiff_t>(expanded), children.end(),
+				[](const Child &lhs, const Child &rhs) -> bool { return lhs.score > rhs.score; });
+
+			if (remainingDepth <= 1)
+			{
+				return children.front().score;
+			}
+
+			float result = lostScore;
+
+			for (usize i = 0; i < expanded; ++i)
+			{
+				const Child &child = children[i];
+				result = std::max(result, child.reward + Search(child.node, remainingDepth - 1, childDepth + 1, context));
+			}
+
+			return result;
+		}
+
+		// The value of a node with remainingDepth more pieces to place, not counting rewards already on the way to it.
+		float Search(const Node &node, int remainingDepth, usize contextDepth, SearchContext &context) const
+		{
+			std::uint64_t key = GetKey(node, remainingDepth);
+			TranspositionEntry entry = TranspositionEntry();
+
+			if (table->Probe(key, entry) && entry.depth >= remainingDepth)
+			{
+				return entry.score;
+			}
+
+			float result = 0.0f;
+
+			if (node.next < pieces.size())
+			{
+				GenerateKnownChildren(node, context.children[contextDepth], context.landingKeys);
+				result = SearchChildren(contextDepth, remainingDepth, context);
+			}
+			else
+			{
+				// the piece isn't visible yet, so it's any of what's left in the bag
+				for (usize piece = 1; piece < node.bag.counts.size(); ++piece)
+				{
+					if (node.bag.counts[piece] == 0)
+					{
+						continue;
+					}
+
+					BagState bag = node.bag.Draw(piece);
+					std::vector<Child> &children = context.children[contextDepth];
+					children.clear();
+					GenerateChildren(node, piece, node.next, node.held, false, bag, children, context.landingKeys);
+
+					if (node.held != 0 && node.held != piece)
+					{
+						GenerateChildren(node, node.held, node.next, piece, true, bag, children, context.landingKeys);
+					}
+
+					result += node.bag.GetProbability(piece) * SearchChildren(contextDepth, remainingDepth, context);
+				}
+			}
+
+			table->Store(key, result, Placement::None(), remainingDepth);
+			return result;
+		}
+
+		// See PerfectClearFinder::GetContext()
+		SearchContext &GetContext() noexcept
+		{
+			usize worker = scheduler->GetCurrentWorkerIndex();
+			return contexts[worker != Threading::noAffinity ? worker : contexts.size() - 1];
+		}
+
+	public:
+		/// @param depth How many pieces to look ahead, the current one included
+		/// @param previewCount How much of the next queue the player gets to see, the rest is left to chance
+		/// @param scheduler Where the expanded root children are searched, one with no workers keeps it all on the calling thread
+		ExpectimaxPlayer(TranspositionTable &table, int depth = 3, usize beamWidth = 6, usize previewCount = 5,
+			const EvaluationWeights &weights = EvaluationWeights::defaultWeights, Scheduler &scheduler = Scheduler::GetShared()) : 
+			table(std::addressof(table)), weights(weights), depth(std::max(depth, 1)), beamWidth(std::max(beamWidth, static_cast<usize>(1))), 
+			previewCount(previewCount), scheduler(std::addressof(scheduler)), contexts(scheduler.GetConcurrency()), pieces(), queueKeys() {}
+
+		/// @return The placement to make next, null if the piece fits nowhere. Pass it to ApplyPlacement().
+		Nullable<Placement> Choose(const BasicBoard<Width, Height> &board)
+		{
+			pieces.assign(1, GetTetrominoIndex(board.GetTetrominoType()));
+
+			for (const Tetromino &tetromino : board.GetNextQueue())
+			{
+				if (pieces.size() > previewCount)
+				{
+					break;
+				}
+
+				pieces.push_back(GetTetrominoIndex(tetromino.tetrominoType));
+			}
+
+			queueKeys.assign(pieces.size() + 1, 0);
+
+			for (usize i = pieces.size(); i-- > 0;)
+			{
+				std::uint64_t state = queueKeys[i + 1] * 8 + pieces[i];
+				queueKeys[i] = Randomizers::SplitMix64(state);
+			}
+
+			const Tetromino *held = board.GetHoldQueue().TryGet();
+			Node root = Node { Rows(), 0, 0, held != nullptr ? GetTetrominoIndex(held->tetrominoType) : 0, BagState::FromBoard(board, previewCount) };
+			std::copy(board.GetRowMasks().begin(), board.GetRowMasks().end(), root.rows.begin());
+			root.rowsKey = GetRowsKey(root.rows);
+			table->NewSearch();
+
+			SearchContext rootContext = SearchContext();
+			rootContext.children.resize(1);
+			std::vector<Child> &children = rootContext.children[0];
+			GenerateKnownChildren(root, children, rootContext.landingKeys);
+
+			if (children.empty())
+			{
+				return Nullable<Placement>();
+			}
+
+			EvaluateBatch(children);
+			usize expanded = std::min(beamWidth, children.size());
+			std::partial_sort(children.begin(), children.begin() + static_cast<std::ptrdiff_t>(expanded), children.end(),
+				[](const Child &lhs, const Child &rhs) -> bool { return lhs.score > rhs.score; });
+
+			if (depth <= 1)
+			{
+				return children.front().placement;
+			}
+
+			std::vector<float> scores = std::vector<float>(expanded, lostScore);
+
+			Threading::ParallelFor(*scheduler, 0, expanded, [&](usize i) -> void
+			{
+				SearchContext &context = GetContext();
+				context.children.resize(static_cast<usize>(depth)); // sized up front, the levels above hold on to theirs while deeper ones run
+				scores[i] = children[i].reward + Search(children[i].node, depth - 1, 0, context);
+			});
+
+			usize best = static_cast<usize>(std::max_element(scores.begin(), scores.end()) - scores.begin());
+			return children[best].placement;
+		}
+	};
+}
+
+#endif // !SEARCH_DEFINED
@@ -0,0 +1,201 @@
+#ifndef SIMD_DEFINED
+#define SIMD_DEFINED
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+#include "Lib.hpp"
+
+// Picked at compile time from what the compiler is allowed to emit (-mavx2 / /arch:AVX2, SSE2 is a given on x64).
+// Define LIB_NO_SIMD to force the scalar paths, e.g. to compare results against them.
+#if !defined(LIB_NO_SIMD) && defined(__AVX2__)
+	#define LIB_SIMD_AVX2
+	#define LIB_SIMD_SSE2
+	#include <immintrin.h>
+#elif !defined(LIB_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define LIB_SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
+#if !defined(LIB_NO_SIMD) && defined(__BMI2__)
+	#define LIB_SIMD_BMI2
+	#include <immintrin.h>
+#endif
+
+// Kernels over arrays of row bitmasks (bit i of a row is column i), as kept by Stacker::BasicBoard.
+// Row sets are returned as a 64-bit mask with bit i standing for rows[i], so count must be at most 64.
+namespace Lib::Simd
+{
+	namespace
+	{
+		template <typename TRow>
+		std::uint64_t FullRowsScalar(const TRow *rows, const TRow *overlay, usize start, usize count, TRow fullMask) noexcept
+		{
+			std::uint64_t result = 0;
+
+			for (usize i = start; i < count; ++i)
+			{
+				TRow row = overlay != nullptr ? static_cast<TRow>(rows[i] | overlay[i]) : rows[i];
+
+				if (row == fullMask)
+				{
+					result |= static_cast<std::uint64_t>(1) << i;
+				}
+			}
+
+			return result;
+		}
+
+#ifdef LIB_SIMD_SSE2
+		template <typename TRow>
+		__m128i Load128(const TRow *rows, const TRow *overlay, usize i) noexcept
+		{
+			__m128i result = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + i));
+			return overlay != nullptr ? _mm_or_si128(result, _mm_loadu_si128(reinterpret_cast<const __m128i *>(overlay + i))) : result;
+		}
+#endif
+
+#ifdef LIB_SIMD_AVX2
+		template <typename TRow>
+		__m256i Load256(const TRow *rows, const TRow *overlay, usize i) noexcept
+		{
+			__m256i result = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + i));
+			return overlay != nullptr ? _mm256_or_si256(result, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(overlay + i))) : result;
+		}
+#endif
+	}
+
+	/// @brief Finds the rows equal to fullMask, after OR-ing in overlay when it isn't null (e.g. a ghost piece, to preview a clear).
+	/// @return Bit i is set if row i is full
+	template <typename TRow> requires std::is_unsigned_v<TRow>
+	std::uint64_t FullRows(const TRow *rows, const TRow *overlay, usize count, TRow fullMask) noexcept
+	{
+		std::uint64_t result = 0;
+		usize i = 0;
+		count = std::min(count, static_cast<usize>(64)); // all the result has room for, and without it GCC can't tell the loops end
+
+		if constexpr (sizeof(TRow) == 2)
+		{
+#ifdef LIB_SIMD_AVX2
+			__m256i full = _mm256_set1_epi16(static_cast<short>(fullMask));
+
+			for (; i + 16 <= count; i += 16)
+			{
+				__m256i equal = _mm256_cmpeq_epi16(Load256(rows, overlay, i), full);
+				// packing works per 128-bit lane, so rows 0-7 land in bits 0-7 and rows 8-15 in bits 16-23
+				std::uint32_t bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_packs_epi16(equal, _mm256_setzero_si256())));
+				result |= static_cast<std::uint64_t>((bits & 0xFF) | ((bits >> 8) & 0xFF00)) << i;
+			}
+#endif
+#ifdef LIB_SIMD_SSE2
+			__m128i fullLow = _mm_set1_epi16(static_cast<short>(fullMask));
+
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i equal = _mm_cmpeq_epi16(Load128(rows, overlay, i), fullLow);
+				std::uint32_t bits = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(equal, _mm_setzero_si128())));
+				result |= static_cast<std::uint64_t>(bits & 0xFF) << i;
+			}
+#endif
+		}
+		else if constexpr (sizeof(TRow) == 4)
+		{
+#ifdef LIB_SIMD_AVX2
+			__m256i full = _mm256_set1_epi32(static_cast<int>(fullMask));
+
+			for (; i + 8 <= count; i += 8)
+			{
+				__m256i equal = _mm256_cmpeq_epi32(Load256(rows, overlay, i), full);
+				result |= static_cast<std::uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(equal))) << i;
+			}
+#endif
+#ifdef LIB_SIMD_SSE2
+			__m128i fullLow = _mm_set1_epi32(static_cast<int>(fullMask));
+
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128i equal = _mm_cmpeq_epi32(Load128(rows, overlay, i), fullLow);
+				result |= static_cast<std::uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(equal))) << i;
+			}
+#endif
+		}
+
+		return result | FullRowsScalar(rows, overlay, i, count, fullMask);
+	}
+
+	template <typename TRow> requires std::is_unsigned_v<TRow>
+	std::uint64_t FullRows(const TRow *rows, usize count, TRow fullMask) noexcept
+	{
+		return FullRows(rows, static_cast<const TRow *>(nullptr), count, fullMask);
+	}
+
+	/// @brief Whether every row is 0, i.e. the board is empty.
+	template <typename TRow> requires std::is_unsigned_v<TRow>
+	bool AllZero(const TRow *rows, usize count) noexcept
+	{
+		const unsigned char *bytes = reinterpret_cast<const unsigned char *>(rows);
+		usize byteCount = count * sizeof(TRow);
+		usize i = 0;
+
+#ifdef LIB_SIMD_AVX2
+		__m256i anySet256 = _mm256_setzero_si256();
+
+		for (; i + 32 <= byteCount; i += 32)
+		{
+			anySet256 = _mm256_or_si256(anySet256, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i)));
+		}
+
+		if (!_mm256_testz_si256(anySet256, anySet256))
+		{
+			return false;
+		}
+#endif
+#ifdef LIB_SIMD_SSE2
+		__m128i anySet = _mm_setzero_si128();
+
+		for (; i + 16 <= byteCount; i += 16)
+		{
+			anySet = _mm_or_si128(anySet, _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i)));
+		}
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(anySet, _mm_setzero_si128())) != 0xFFFF)
+		{
+			return false;
+		}
+#endif
+
+		for (; i < byteCount; ++i)
+		{
+			if (bytes[i] != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/// @brief Removes the bits set in removed from value and packs the remaining ones down, e.g. to drop cleared rows from a column mask.
+	inline std::uint64_t RemoveBits(std::uint64_t value, std::uint64_t removed) noexcept
+	{
+#ifdef LIB_SIMD_BMI2
+		return _pext_u64(value, ~removed);
+#else
+		while (removed != 0) // highest first, so the lower positions still line up
+		{
+			int bit = static_cast<int>(std::bit_width(removed)) - 1;
+			std::uint64_t below = (static_cast<std::uint64_t>(1) << bit) - 1;
+			value = (value & below) | ((value >> 1) & ~below);
+			removed &= below;
+		}
+
+		return value;
+#endif
+	}
+}
+
+#endif // !SIMD_DEFINED
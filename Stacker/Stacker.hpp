@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
 #include <deque>
 #include <queue>
@@ -10,11 +11,16 @@
 #include <utility>
 #include <bit>
 #include <memory>
+#include <cstdint>
+#include <span>
+#include <string_view>
 
 #include "Lib.hpp"
 #include "Time.hpp"
+#include "Timeline.hpp"
 #include "Memory.hpp"
 #include "Collections.hpp"
+#include "Simd.hpp"
 #include "Randomizers.hpp"
 #include "SdlLib.hpp"
 
@@ -261,66 +267,67 @@ namespace Stacker
 			return longB2bStreakBroken ? SDL_Color { 206, 82, 90, 255 } : SDL_Color { 206, 197, 82, 255 };
 		}
 
-		constexpr string GetComboText() const noexcept
+		// The texts live in the scratch arena (see Allocation::ScratchText), so they are gone two frames later and null terminated.
+		std::string_view GetComboText() const
 		{
 			if (combo > 0)
 			{
-				return std::to_string(combo) + " COMBO";
+				return Allocation::ScratchText({ combo, " COMBO" });
 			}
 			else
 			{
-				return string();
+				return std::string_view();
 			}
 		}
 
-		constexpr string GetB2bText() const noexcept
+		std::string_view GetB2bText() const
 		{
 			if (b2b > 0)
 			{
-				return "B2B x" + std::to_string(b2b);
+				return Allocation::ScratchText({ "B2B x", b2b });
 			}
 			else if (longB2bStreakBroken)
 			{
-				return string("B2B x0");
+				return std::string_view("B2B x0");
 			}
 			else
 			{
-				return string();
+				return std::string_view();
 			}
 		}
 		
-		constexpr string GetLineClearText() const noexcept
+		constexpr std::string_view GetLineClearText() const noexcept
 		{
 			if (linesCleared > 0 && linesCleared < 5)
 			{
-				constexpr const char *texts[4] = { "SINGLE", "DOUBLE", "TRIPLE", "QUAD" };
-				return string(texts[linesCleared - 1]);
+				constexpr std::string_view texts[4] = { "SINGLE", "DOUBLE", "TRIPLE", "QUAD" };
+				return texts[linesCleared - 1];
 			}
 			else if (linesCleared >= 5)
 			{
-				return string("QUAD+");
+				return std::string_view("QUAD+");
 			}
 			else
 			{
-				return string();
+				return std::string_view();
 			}
 		}
 
-		constexpr string GetAllClearText() const noexcept
+		constexpr std::string_view GetAllClearText() const noexcept
 		{
-			return isAllClear ? string("ALL CLEAR") : string();
+			return isAllClear ? std::string_view("ALL CLEAR") : std::string_view();
 		}
 
-		constexpr string GetSpinText() const noexcept
+		std::string_view GetSpinText() const
 		{
 			if (IsValidTetrominoType(tetrominoType) && spinType != SpinType::None)
 			{
-				return spinType == SpinType::Spin ? (string(1, static_cast<char>(tetrominoType)) + "-SPIN") : 
-					("MINI " + string(1, static_cast<char>(tetrominoType)) + "-SPIN");
+				return spinType == SpinType::Spin ? Allocation::ScratchText({ static_cast<char>(tetrominoType), "-SPIN" }) :
+					Allocation::ScratchText({ "MINI ", static_cast<char>(tetrominoType), "-SPIN" });
 			}
 			else
 			{
-				return string();
+				return std::string_view();
 			}
 		}
 	
@@ -360,11 +367,13 @@ public:
 
 namespace Stacker
 {
+	using KickList = SmallList<int2, 6>; // SRS has 5 kicks per rotation, the 180 ones 6
+
 	struct KickTable final
 	{
 	public:
 		TetrominoState states[4];
-		std::unordered_map<RotationChange, std::vector<int2>> kicks;
+		std::unordered_map<RotationChange, KickList> kicks;
 
 		const TetrominoState &GetSpawnState() const noexcept
 		{
@@ -381,12 +390,12 @@ namespace Stacker
 			return states[static_cast<usize>(orientation)];
 		}
 
-		const std::vector<int2> &GetKicks(RotationChange rotationChange) const noexcept
+		const KickList &GetKicks(RotationChange rotationChange) const noexcept
 		{
 			return kicks.at(rotationChange);
 		}
 
-		std::vector<int2> &GetKicks(RotationChange rotationChange) noexcept
+		KickList &GetKicks(RotationChange rotationChange) noexcept
 		{
 			return kicks.at(rotationChange);
 		}
@@ -395,14 +404,14 @@ namespace Stacker
 	struct Tetromino final
 	{
 	public:
-		KickTable kickTable;
-		int2 spawnOffset;
+		const KickTable *kickTable; // one of the shared tables below, so copying a tetromino never copies its kicks
+		int2 spawnOffset; // relative to the board's spawn origin
 		TetrominoType tetrominoType;
 		SDL_Color color;
 
 		TetrominoState GetSpawnState() const noexcept
 		{
-			return kickTable.GetSpawnState() + spawnOffset;
+			return kickTable->GetSpawnState() + spawnOffset;
 		}
 
 		constexpr friend bool operator==(const Tetromino &lhs, const Tetromino &rhs) noexcept
@@ -490,7 +499,7 @@ namespace Stacker
 
 		static constexpr Box Bounding(const Tetromino &tetromino, const TetrominoState &tetrominoState, Orientation orientation)
 		{
-			return Bounding(tetromino.kickTable.states, tetrominoState - tetromino.kickTable.GetState(orientation));
+			return Bounding(tetromino.kickTable->states, tetrominoState - tetromino.kickTable->GetState(orientation));
 		}
 
 		constexpr friend bool operator==(const Box &lhs, const Box &rhs) noexcept
@@ -559,6 +568,12 @@ namespace Stacker
 			return heldPiece;
 		}
 
+		// Null if nothing is held, for a look without copying the piece
+		const Tetromino *TryGet() const noexcept
+		{
+			return heldPiece.HasValue() ? std::addressof(*heldPiece) : nullptr;
+		}
+
 		Nullable<Tetromino> PopAndPush(const Tetromino &tetromino) noexcept // To handle the first hold...
 		{
 			Nullable<Tetromino> result = heldPiece;
@@ -580,12 +595,12 @@ namespace Stacker
 	struct NextQueue final
 	{
 	private:
-		std::deque<Tetromino> tetrominoes;
+		std::vector<Tetromino> tetrominoes; // never changes size, a pop shifts the rest down in place where a deque would allocate
 
 	public:
-		NextQueue(usize size) : tetrominoes(std::deque<Tetromino>(size)) {}
+		NextQueue(usize size) : tetrominoes(std::vector<Tetromino>(size)) {}
 
-		NextQueue(usize size, BagRandomizer<Tetromino> &bagRandomizer) : tetrominoes(std::deque<Tetromino>(size)) 
+		NextQueue(usize size, BagRandomizer<Tetromino> &bagRandomizer) : tetrominoes(std::vector<Tetromino>(size)) 
 		{
 			for (Tetromino &tetromino : tetrominoes)
 			{
@@ -609,45 +624,37 @@ namespace Stacker
 		Tetromino PopAndPush(const Tetromino &tetromino)
 		{
 			Tetromino result = tetrominoes.front();
-			tetrominoes.pop_front();
-			tetrominoes.push_back(tetromino);
-			return result;
-		}
-
-		Tetromino PopAndPush(Tetromino &&tetromino)
-		{
-			Tetromino result = tetrominoes.front();
-			tetrominoes.pop_front();
-			tetrominoes.push_back(tetromino);
+			std::shift_left(tetrominoes.begin(), tetrominoes.end(), 1);
+			tetrominoes.back() = tetromino;
 			return result;
 		}
 
-		std::deque<Tetromino>::const_iterator cbegin() const noexcept
+		std::vector<Tetromino>::const_iterator cbegin() const noexcept
 		{
 			return tetrominoes.cbegin();
 		}
 
-		std::deque<Tetromino>::const_iterator cend() const noexcept
+		std::vector<Tetromino>::const_iterator cend() const noexcept
 		{
 			return tetrominoes.cend();
 		}
 
-		std::deque<Tetromino>::const_iterator begin() const noexcept
+		std::vector<Tetromino>::const_iterator begin() const noexcept
 		{
 			return tetrominoes.begin();
 		}
 
-		std::deque<Tetromino>::const_iterator end() const noexcept
+		std::vector<Tetromino>::const_iterator end() const noexcept
 		{
 			return tetrominoes.end();
 		}
 
-		std::deque<Tetromino>::iterator begin() noexcept
+		std::vector<Tetromino>::iterator begin() noexcept
 		{
 			return tetrominoes.begin();
 		}
 
-		std::deque<Tetromino>::iterator end() noexcept
+		std::vector<Tetromino>::iterator end() noexcept
 		{
 			return tetrominoes.end();
 		}
@@ -683,6 +690,7 @@ namespace Stacker
 		SDL_KeyCode rotateClockwise180Key;
 		SDL_KeyCode rotateCounterclockwise180Key;
 		SDL_KeyCode restartKey;
+		SDL_KeyCode pauseKey;
 
 		static const ControllerBinding defaultBinding;
 	};
@@ -700,6 +708,7 @@ namespace Stacker
 		.rotateClockwise180Key = SDL_KeyCode::SDLK_a,
 		.rotateCounterclockwise180Key = SDL_KeyCode::SDLK_s,
 		.restartKey = SDL_KeyCode::SDLK_r,
+		.pauseKey = SDL_KeyCode::SDLK_p,
 	};
 
 	struct Handling final
@@ -724,6 +733,7 @@ namespace Stacker
 		bool cancelDasOnDirectionChange;
 
 		static const HandlingData defaultHandling;
+		static const HandlingData instantHandling;
 	};
 
 	constexpr inline HandlingData HandlingData::defaultHandling =
@@ -734,7 +744,17 @@ namespace Stacker
 		false
 	};
 
-	std::unordered_map<RotationChange, std::vector<int2>> jlszKicks =
+	// ARR 0 and an infinite primary soft drop, which is what most competitive players run. An ARR of 0 moves the piece
+	// straight to the wall once DAS is charged, and a soft drop ARR of 0 straight to the floor.
+	constexpr inline HandlingData HandlingData::instantHandling =
+	{
+		Handling { 0.1, 0.0 },
+		Handling { 0.0, 0.0 },
+		Handling { 0.0, 1.0 / 5.0 },
+		false
+	};
+
+	std::unordered_map<RotationChange, KickList> jlszKicks =
 	{
 		{ { Orientation::North, RotateDirection::Clockwise }, { {0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2} }},
 		{ { Orientation::East, RotateDirection::Clockwise }, { {0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2} } },
@@ -754,7 +774,7 @@ namespace Stacker
 		{ { Orientation::West, RotateDirection::Counterclockwise180 }, { {0, 0}, {-1, 0}, {-1, 2}, {-1, 1}, {0, 2}, {0, 1} } }
 	};
 
-	std::unordered_map<RotationChange, std::vector<int2>> iKicks =
+	std::unordered_map<RotationChange, KickList> iKicks =
 	{
 		{ { Orientation::North, RotateDirection::Clockwise }, { {0, 0}, {1, 0}, {-2, 0}, {-2, -1}, {1, 2} } },
 		{ { Orientation::East, RotateDirection::Clockwise }, { {0, 0}, {-1, 0}, {2, 0}, {-1, 2}, {2, -1} } },
@@ -774,7 +794,7 @@ namespace Stacker
 		{ { Orientation::West, RotateDirection::Counterclockwise180 }, { {0, 0}, {-1, 0}, {-1, 2}, {-1, 1}, {0, 2}, {0, 1} } }
 	};
 
-	std::unordered_map<RotationChange, std::vector<int2>> oKicks = std::unordered_map<RotationChange, std::vector<int2>>
+	std::unordered_map<RotationChange, KickList> oKicks = std::unordered_map<RotationChange, KickList>
 	{
 		{ { Orientation::North, RotateDirection::Clockwise }, { {0, 0} } },
 		{ { Orientation::East, RotateDirection::Clockwise }, { {0, 0} } },
@@ -794,7 +814,7 @@ namespace Stacker
 		{ { Orientation::West, RotateDirection::Counterclockwise180 }, { {0, 0} } }
 	};
 
-	std::unordered_map<RotationChange, std::vector<int2>> tKicks =
+	std::unordered_map<RotationChange, KickList> tKicks =
 	{
 		{ { Orientation::North, RotateDirection::Clockwise }, { {0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2} }},
 		{ { Orientation::East, RotateDirection::Clockwise }, { {0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2} } },
@@ -894,13 +914,13 @@ namespace Stacker
 
 	std::vector<Tetromino> tetrominoVector = 
 	{
-		{ iKickTable, int2 { 3, 19 }, TetrominoType::I, SDL_Color { 82, 207, 173, 255 } },
-		{ jKickTable, int2 { 3, 20 }, TetrominoType::J, SDL_Color { 103, 81, 206, 255 } },
-		{ lKickTable, int2 { 3, 20 }, TetrominoType::L, SDL_Color { 206, 129, 82, 255 } },
-		{ oKickTable, int2 { 3, 20 }, TetrominoType::O, SDL_Color { 206, 197, 82, 255 } },
-		{ sKickTable, int2 { 3, 20 }, TetrominoType::S, SDL_Color { 129, 207, 82, 255 } },
-		{ tKickTable, int2 { 3, 20 }, TetrominoType::T, SDL_Color { 195, 82, 206, 255 } },
-		{ zKickTable, int2 { 3, 20 }, TetrominoType::Z, SDL_Color { 206, 82, 90, 255 } }
+		{ &iKickTable, int2 { 0, -1 }, TetrominoType::I, SDL_Color { 82, 207, 173, 255 } },
+		{ &jKickTable, int2 { 0, 0 }, TetrominoType::J, SDL_Color { 103, 81, 206, 255 } },
+		{ &lKickTable, int2 { 0, 0 }, TetrominoType::L, SDL_Color { 206, 129, 82, 255 } },
+		{ &oKickTable, int2 { 0, 0 }, TetrominoType::O, SDL_Color { 206, 197, 82, 255 } },
+		{ &sKickTable, int2 { 0, 0 }, TetrominoType::S, SDL_Color { 129, 207, 82, 255 } },
+		{ &tKickTable, int2 { 0, 0 }, TetrominoType::T, SDL_Color { 195, 82, 206, 255 } },
+		{ &zKickTable, int2 { 0, 0 }, TetrominoType::Z, SDL_Color { 206, 82, 90, 255 } }
 	};
 
 	SDL_Color LineClearData::GetColor() const noexcept
@@ -922,7 +942,66 @@ namespace Stacker
 
 namespace Stacker
 {
-	class Board; 
+	template <const int Width, const int Height>
+	class BasicBoard;
+
+	constexpr usize GetTetrominoIndex(TetrominoType tetrominoType) noexcept
+	{
+		switch (tetrominoType)
+		{
+			case TetrominoType::I: return 1;
+			case TetrominoType::J: return 2;
+			case TetrominoType::L: return 3;
+			case TetrominoType::O: return 4;
+			case TetrominoType::S: return 5;
+			case TetrominoType::T: return 6;
+			case TetrominoType::Z: return 7;
+			default: return 0;
+		}
+	}
+
+	// Keys for Zobrist hashing a board. Generated at compile time from a fixed seed, so hashes agree across runs and builds.
+	template <const int Width, const int Height>
+	struct ZobristKeys final
+	{
+	public:
+		static constexpr usize tetrominoTypeCount = 8; // none and the 7 pieces
+		static constexpr usize maxQueueLength = 16;
+		static constexpr usize maxStreak = 31; // b2b and combo past this share a key, only absurd streaks get there
+
+		std::array<std::uint64_t, static_cast<usize>(Width * Height)> cells; // row-major, an occupied cell of any type
+		std::array<std::uint64_t, tetrominoTypeCount> activePiece;
+		std::array<std::uint64_t, tetrominoTypeCount> heldPiece;
+		std::array<std::uint64_t, maxQueueLength * tetrominoTypeCount> nextQueue; // per slot, so order matters
+		std::array<std::uint64_t, maxStreak + 1> b2b; // offset by one, -1 (no streak) is index 0
+		std::array<std::uint64_t, maxStreak + 1> combo;
+
+		static constexpr ZobristKeys Generate(std::uint64_t seed) noexcept
+		{
+			ZobristKeys result = ZobristKeys();
+
+			auto fill = [&seed](auto &keys) -> void
+			{
+				for (std::uint64_t &key : keys)
+				{
+					key = SplitMix64(seed);
+				}
+			};
+
+			fill(result.cells);
+			fill(result.activePiece);
+			fill(result.heldPiece);
+			fill(result.nextQueue);
+			fill(result.b2b);
+			fill(result.combo);
+			return result;
+		}
+
+		static constexpr usize GetStreakIndex(int streak) noexcept
+		{
+			return static_cast<usize>(std::clamp(streak + 1, 0, static_cast<int>(maxStreak)));
+		}
+	};
 
 	class Controller final // TODO: Merge with Stacker::Board?
 	{
@@ -938,6 +1017,7 @@ namespace Stacker
 		Input hardDropInput;
 		Input holdInput;
 		Input restartInput;
+		Input pauseInput;
 		DasArrTimer movementTimer;
 		Timer softDropTimer;
 		Handling primarySoftDropHandling;
@@ -952,6 +1032,7 @@ namespace Stacker
 		bool rotateCounterclockwise180Pressed;
 		bool holdPressed;
 		bool restartPressed;
+		bool pausePressed;
 			
 		/*Timer primarySoftDropDasTimer;
 		Timer secondarySoftDropDasTimer;*/
@@ -962,12 +1043,12 @@ namespace Stacker
 			rotateCounterclockwiseInput(Input(controllerBinding.rotateCounterclockwiseKey)), rotateClockwise180Input(Input(controllerBinding.rotateClockwise180Key)),
 		    rotateCounterclockwise180Input(Input(controllerBinding.rotateCounterclockwise180Key)), primarySoftDropInput(Input(controllerBinding.primarySoftDropKey)),
 			secondarySoftDropInput(Input(controllerBinding.secondarySoftDropKey)), hardDropInput(Input(controllerBinding.hardDropKey)),
-			holdInput(Input(controllerBinding.holdKey)), restartInput(controllerBinding.restartKey), movementTimer(DasArrTimer(handlingData.movement.das, handlingData.movement.arr)),
+			holdInput(Input(controllerBinding.holdKey)), restartInput(controllerBinding.restartKey), pauseInput(controllerBinding.pauseKey), movementTimer(DasArrTimer(handlingData.movement.das, handlingData.movement.arr)),
 			softDropTimer(Timer(handlingData.primarySoftDrop.arr)), primarySoftDropHandling({ handlingData.primarySoftDrop.das, handlingData.primarySoftDrop.arr }),
 			secondarySoftDropHandling({ handlingData.secondarySoftDrop.das, handlingData.secondarySoftDrop.arr }),
 			direction(0), pressedSoftDropButton(SoftDropButton::None), pressedMoveButton(MoveButton::None), hardDropPressed(false), 
 			rotateClockwisePressed(false), rotateCounterclockwisePressed(false), rotateClockwise180Pressed(false), rotateCounterclockwise180Pressed(false),
-			holdPressed(false), restartPressed(false)
+			holdPressed(false), restartPressed(false), pausePressed(false)
 		{
 			movementTimer.Reset();
 		}
@@ -984,165 +1065,341 @@ namespace Stacker
 			return pressedSoftDropButton;
 		}
 
-		void UpdateEvent(const SDL_Event &event, Board &board) noexcept;
-		void Update(DeltaTime deltaTime, Board &board) noexcept;
+		// Forgets every held gameplay key, so nothing keeps moving after a pause. The pause key itself is left alone.
+		void ReleaseInputs() noexcept
+		{
+			movementTimer.Reset();
+			direction = 0;
+			pressedSoftDropButton = SoftDropButton::None;
+			pressedMoveButton = MoveButton::None;
+			hardDropPressed = false;
+			rotateClockwisePressed = false;
+			rotateCounterclockwisePressed = false;
+			rotateClockwise180Pressed = false;
+			rotateCounterclockwise180Pressed = false;
+			holdPressed = false;
+			restartPressed = false;
+		}
+
+		template <typename TBoard>
+		void UpdateEvent(const SDL_Event &event, TBoard &board) noexcept;
+
+		template <typename TBoard>
+		void Update(DeltaTime deltaTime, TBoard &board) noexcept;
 	};
 
-	class Board final
+	// Width and height are in tiles and include the hidden rows above the visible field, which are the upper half.
+	template <const int Width, const int Height>
+	class BasicBoard final
 	{
+		static_assert(Width >= 4 && Height >= 4, "Every tetromino has to fit the board when it spawns");
+		static_assert(Width <= 64 && Height <= 64, "Rows are kept as 64-bit masks at most, and row sets as a 64-bit mask");
+
+	public:
+		static constexpr int width = Width;
+		static constexpr int height = Height;
+		static constexpr int visibleHeight = Height / 2;
+		static constexpr int2 spawnOrigin = int2 { (Width - 4) / 2, Height / 2 };
+
+		// bit i is column i, kept next to boardState so collision and clear checks don't have to look at the tiles
+		using RowMask = std::conditional_t<(Width <= 16), std::uint16_t, std::conditional_t<(Width <= 32), std::uint32_t, std::uint64_t>>;
+		static constexpr RowMask fullRowMask = static_cast<RowMask>(~static_cast<std::uint64_t>(0) >> (64 - Width));
+		static constexpr ZobristKeys<Width, Height> zobristKeys = ZobristKeys<Width, Height>::Generate(0x5AC4E75EED);
+
 	private:
 		BagRandomizer<Tetromino> randomizer;
 		HoldQueue holdQueue;
 		NextQueue nextQueue;
 		Matrix<TetrominoType> boardState;
+		std::array<RowMask, Height> rowMasks;
+		std::array<std::uint64_t, Width> columnMasks; // bit i is row i, for drop distances
 		Controller controller;
-		RectSize boardSize;
 		Tetromino currentTetromino;
 		TetrominoState currentTetrominoPositions;
-		TetrominoState currentGhostPositions;
+		mutable TetrominoState currentGhostPositions;
 		Orientation currentOrientation;
 		Timer gravityTimer;
 		bool gravityState;
-		std::vector<int> clearedRows;
+		bool paused;
+		mutable bool derivedStateDirty; // the ghost and the cleared rows are only worked out once someone asks for them
+		mutable SmallList<int, 4> clearedRows; // a piece spans 4 rows at most
 		LineClearData previousLineClearData; // the one that's actually used for rendering...
 		LineClearData currentLineClearData;
-		double textFadeTimer; // for text fading purposes
+		TimelineScheduler timelines; // effects and delays, advanced by Update() in whole ticks
+		DeltaTime tickRemainder; // the part of Update()'s time that didn't make a whole tick yet
+		TimelineId textFade;
+		Uint8 textAlpha;
 		usize score;
+		usize stateVersion; // bumped on every visible change, so renderers can tell when a frame would look the same
+		std::uint64_t hash; // Zobrist hash of the cells, the current piece, hold, next queue, b2b and combo, kept up to date incrementally
 
-		Tetromino GetNext()
+		void MarkChanged() noexcept
 		{
-			return nextQueue.PopAndPush(randomizer.GetNext());
+			++stateVersion;
 		}
 
-		TetrominoState CalculateGhostPositions() const
+		void SetTextAlpha(Uint8 alpha) noexcept
+		{
+			if (alpha != textAlpha)
+			{
+				textAlpha = alpha;
+				MarkChanged();
+			}
+		}
+
+		// Full alpha for textFadeDelay, then linearly down to 0 over textFadeLength, waking only when the alpha actually changes
+		Timeline FadeText(TimelineScheduler &)
 		{
-			int2 offsets = { 0, 0 };
+			SetTextAlpha(255);
+			co_await Ticks(textFadeDelay);
+			Tick elapsed = 0;
 
-			if (CanMove(offsets))
+			while (textAlpha > 0)
 			{
-				while (CanMove(offsets))
-				{
-					--offsets.y;
-				}
+				// the first tick whose alpha, (textFadeLength - t) * 255 / textFadeLength, is below the current one
+				Tick next = textFadeLength - (static_cast<Tick>(textAlpha) * textFadeLength - 1) / 255;
+				co_await Ticks(next - elapsed);
+				elapsed = next;
+				SetTextAlpha(static_cast<Uint8>((textFadeLength - elapsed) * 255 / textFadeLength));
+			}
+		}
+
+		void RestartTextFade()
+		{
+			timelines.Cancel(textFade);
+			textFade = timelines.Start(FadeText(timelines));
+		}
+
+		Tetromino GetNext()
+		{
+			hash ^= GetNextQueueKey();
+			Tetromino result = nextQueue.PopAndPush(randomizer.GetNext());
+			hash ^= GetNextQueueKey();
+			return result;
+		}
 
-				return currentTetrominoPositions + offsets + int2{ 0, 1 };
+		void SetCurrentTetromino(const Tetromino &tetromino) noexcept
+		{
+			hash ^= zobristKeys.activePiece[GetTetrominoIndex(currentTetromino.tetrominoType)] ^
+				zobristKeys.activePiece[GetTetrominoIndex(tetromino.tetrominoType)];
+			currentTetromino = tetromino;
+		}
+
+		static std::uint64_t GetCellKey(int row, int column) noexcept
+		{
+			return zobristKeys.cells[static_cast<usize>(row * Width + column)];
+		}
+
+		static std::uint64_t GetRowKey(int row, std::uint64_t rowMask) noexcept
+		{
+			std::uint64_t result = 0;
+
+			for (; rowMask != 0; rowMask &= rowMask - 1)
+			{
+				result ^= GetCellKey(row, std::countr_zero(rowMask));
 			}
-			else
+
+			return result;
+		}
+
+		std::uint64_t GetHeldPieceKey() const noexcept
+		{
+			const Tetromino *heldPiece = holdQueue.TryGet();
+			return zobristKeys.heldPiece[heldPiece != nullptr ? GetTetrominoIndex(heldPiece->tetrominoType) : 0];
+		}
+
+		std::uint64_t GetNextQueueKey() const noexcept
+		{
+			std::uint64_t result = 0;
+			usize slot = 0;
+
+			for (const Tetromino &tetromino : nextQueue)
 			{
-				return currentTetrominoPositions;
+				result ^= zobristKeys.nextQueue[slot * ZobristKeys<Width, Height>::tetrominoTypeCount + GetTetrominoIndex(tetromino.tetrominoType)];
+				++slot;
 			}
+
+			return result;
 		}
 
-		int CalculateClearedLineCount() const
+		std::uint64_t GetStreakKey() const noexcept
+		{
+			return zobristKeys.b2b[ZobristKeys<Width, Height>::GetStreakIndex(currentLineClearData.b2b)] ^
+				zobristKeys.combo[ZobristKeys<Width, Height>::GetStreakIndex(currentLineClearData.combo)];
+		}
+
+		void RebuildMasks() noexcept
 		{
-			TetrominoState ghost = CalculateGhostPositions();
-			int result = 0;
+			columnMasks.fill(0);
 
-			for (int row = 0; row < 40; ++row)
+			for (int row = 0; row < height; ++row)
 			{
-				bool cleared = true;
+				RowMask mask = 0;
 
-				for (int column = 0; column < 10; ++column)
+				for (int column = 0; column < width; ++column)
 				{
-					if (!(IsValidTetrominoType(boardState[int2{ row, column }]) || ghost.Contains(int2{ column, row })))
+					if (IsValidTetrominoType(boardState[int2{ row, column }]))
 					{
-						cleared = false;
-						break;
+						mask |= static_cast<RowMask>(static_cast<RowMask>(1) << column);
+						columnMasks[static_cast<usize>(column)] |= static_cast<std::uint64_t>(1) << row;
 					}
 				}
 
-				if (cleared)
+				rowMasks[static_cast<usize>(row)] = mask;
+			}
+		}
+
+		void InvalidateDerivedState() noexcept
+		{
+			derivedStateDirty = true;
+		}
+
+		void UpdateDerivedState() const
+		{
+			if (derivedStateDirty)
+			{
+				currentGhostPositions = CalculateGhostPositions();
+				clearedRows.Clear();
+
+				for (std::uint64_t rows = CalculateClearedRowSet(currentGhostPositions); rows != 0; rows &= rows - 1)
 				{
-					++result;
+					clearedRows.Add(std::countr_zero(rows));
 				}
+
+				derivedStateDirty = false;
+			}
+		}
+
+		// Bit i is set if row i would be full with the ghost piece locked in.
+		std::uint64_t CalculateClearedRowSet(const TetrominoState &ghost) const noexcept
+		{
+			std::array<RowMask, Height> ghostMasks = std::array<RowMask, Height>();
+
+			for (int2 position : ghost)
+			{
+				ghostMasks[static_cast<usize>(position.y)] |= static_cast<RowMask>(static_cast<RowMask>(1) << position.x);
+			}
+
+			return Simd::FullRows(rowMasks.data(), ghostMasks.data(), Height, fullRowMask);
+		}
+
+	public:
+		TetrominoState CalculateGhostPositions() const
+		{
+			if (CanMove(int2 { 0, 0 }))
+			{
+				return currentTetrominoPositions - int2 { 0, GetDropDistance() };
+			}
+			else
+			{
+				return currentTetrominoPositions;
+			}
+		}
+
+		// How far the current piece can fall, straight from the column masks, so it costs the same however far that is.
+		int GetDropDistance() const noexcept
+		{
+			int result = height;
+
+			for (int2 position : currentTetrominoPositions)
+			{
+				std::uint64_t below = columnMasks[static_cast<usize>(position.x)] & ((static_cast<std::uint64_t>(1) << position.y) - 1);
+				result = std::min(result, position.y - static_cast<int>(std::bit_width(below)));
 			}
 
 			return result;
 		}
 
-		std::vector<int> CalculateClearedLines() const
+		// How far the current piece can move sideways (direction is -1 or 1) before hitting the stack or a wall, from the row masks.
+		int GetMoveDistance(int direction) const noexcept
 		{
-			std::vector<int> result = std::vector<int>();
-			TetrominoState ghost = CalculateGhostPositions();
+			int result = width;
 
-			for (int row = 0; row < 40; ++row)
+			for (int2 position : currentTetrominoPositions)
 			{
-				bool cleared = true;
+				std::uint64_t row = rowMasks[static_cast<usize>(position.y)];
 
-				for (int column = 0; column < 10; ++column)
+				if (direction > 0)
 				{
-					if (!(IsValidTetrominoType(boardState[int2{ row, column }]) || ghost.Contains(int2{ column, row })))
-					{
-						cleared = false;
-						break;
-					}
+					std::uint64_t ahead = position.x + 1 < 64 ? row >> (position.x + 1) : 0;
+					result = std::min(result, std::min(std::countr_zero(ahead), width - 1 - position.x));
 				}
-
-				if (cleared)
+				else
 				{
-					result.push_back(row);
+					std::uint64_t behind = row & ((static_cast<std::uint64_t>(1) << position.x) - 1);
+					result = std::min(result, position.x - static_cast<int>(std::bit_width(behind)));
 				}
 			}
 
 			return result;
 		}
 
-		int SoftDropOnly(int steps)
+		int CalculateClearedLineCount() const
 		{
-			int actualSteps = 0;
+			return std::popcount(CalculateClearedRowSet(CalculateGhostPositions()));
+		}
 
-			while (actualSteps != steps)
-			{
-				++actualSteps;
+		// Lowest first, in the scratch arena (see Allocation::ScratchArray), CalculateClearedRowSet() is there to keep them around longer.
+		std::span<int> CalculateClearedLines() const
+		{
+			std::uint64_t rows = CalculateClearedRowSet(CalculateGhostPositions());
+			std::span<int> result = Allocation::ScratchArray<int>(static_cast<usize>(std::popcount(rows)));
 
-				if (IsOccupied(currentTetrominoPositions - int2{ 0, actualSteps }))
-				{
-					--actualSteps;
-					break;
-				}
+			for (int &line : result)
+			{
+				line = std::countr_zero(rows);
+				rows &= rows - 1;
 			}
 
+			return result;
+		}
+
+	private:
+		int SoftDropOnly(int steps)
+		{
+			int actualSteps = steps > 0 ? std::min(steps, GetDropDistance()) : 0;
+
 			if (actualSteps != 0)
 			{
 				currentTetrominoPositions -= int2{ 0, actualSteps };
+				MarkChanged();
 			}
 
 			return actualSteps;
 		}
 
 	public:
-		static constexpr double startFadeThreshold = 1.0;
-		static constexpr double fullyFadedThreshold = 3.0;
+		static constexpr DeltaTime tickTime = 1.0 / 1000.0; // what a Tick of the timelines stands for
+		static constexpr Tick textFadeDelay = 1000;
+		static constexpr Tick textFadeLength = 2000;
+		static constexpr usize nextQueueLength = 5;
 
-		Board() : randomizer(BagRandomizer<Tetromino>(tetrominoVector)), holdQueue(HoldQueue()), nextQueue(NextQueue(5)),
-			boardState(Matrix<TetrominoType>(40, 10, TetrominoType::None)), controller(Controller()), boardSize(RectSize{ 10, 40 }),
-			gravityTimer(Timer(1)), gravityState(true), clearedRows(std::vector<int>()), previousLineClearData(LineClearData::Default()), 
-			currentLineClearData(LineClearData::Default()), textFadeTimer(0.0), score(0)
+		static_assert(nextQueueLength <= ZobristKeys<Width, Height>::maxQueueLength, "Every slot of the next queue needs its own Zobrist keys");
+
+		BasicBoard() : BasicBoard(static_cast<usize>(std::random_device()())) {}
+
+		explicit BasicBoard(usize seed) : BasicBoard(seed, HandlingData::defaultHandling) {}
+
+		BasicBoard(usize seed, const HandlingData &handlingData) : randomizer(BagRandomizer<Tetromino>(tetrominoVector, seed)), holdQueue(HoldQueue()), nextQueue(NextQueue(nextQueueLength)),
+			boardState(Matrix<TetrominoType>(Height, Width, TetrominoType::None)), rowMasks(), columnMasks(), controller(Controller(ControllerBinding::defaultBinding, handlingData)),
+			gravityTimer(Timer(1)), gravityState(true), paused(false), derivedStateDirty(true), clearedRows(SmallList<int, 4>()), previousLineClearData(LineClearData::Default()), 
+			currentLineClearData(LineClearData::Default()), timelines(), tickRemainder(0.0), textFade(TimelineId::None()), textAlpha(255), score(0), 
+			stateVersion(0), hash(0)
 		{
 			nextQueue.Fill(randomizer);
 			currentTetromino = GetNext();
-			currentTetrominoPositions = currentTetromino.GetSpawnState();
-			currentGhostPositions = CalculateGhostPositions();
-			clearedRows = CalculateClearedLines();
+			currentTetrominoPositions = GetSpawnState(currentTetromino);
+			InvalidateDerivedState();
 			currentOrientation = Orientation::North;
 			gravityTimer.SetToMax();
 			currentLineClearData = LineClearData::New(GetTetrominoType());
+			hash = CalculateHash();
+			RestartTextFade();
 		}
 
-		Uint8 GetTextAlpha() const
+		Uint8 GetTextAlpha() const noexcept
 		{
-			if (textFadeTimer <= startFadeThreshold)
-			{
-				return 255;	
-			}
-			else if (textFadeTimer >= fullyFadedThreshold)
-			{
-				return 0;
-			}
-			else
-			{
-				return static_cast<Uint8>((fullyFadedThreshold - textFadeTimer) / (fullyFadedThreshold - startFadeThreshold) * 255.0);
-			}
+			return textAlpha;
 		}
 
 		usize GetBagIndex() const noexcept
@@ -1155,14 +1412,33 @@ namespace Stacker
 			return randomizer.size();
 		}
 
+		// What the current bag still has to hand out, as counts per GetTetrominoIndex(), so the order it comes in doesn't leak.
+		std::array<int, 8> GetBagRemainderCounts() const noexcept
+		{
+			std::array<int, 8> result = std::array<int, 8>();
+			const std::vector<Tetromino> &bag = randomizer.GetBag();
+
+			for (usize i = randomizer.GetIndex(); i < bag.size(); ++i)
+			{
+				++result[GetTetrominoIndex(bag[i].tetrominoType)];
+			}
+
+			return result;
+		}
+
 		usize GetNextSize() const noexcept
 		{
 			return nextQueue.size();
 		}
 
-		RectSize GetBoardSize() const noexcept
+		static constexpr RectSize GetBoardSize() noexcept
+		{
+			return RectSize { Width, Height };
+		}
+
+		static TetrominoState GetSpawnState(const Tetromino &tetromino) noexcept
 		{
-			return boardSize;
+			return tetromino.GetSpawnState() + spawnOrigin;
 		}
 
 		const Matrix<TetrominoType> &GetBoardState() const noexcept
@@ -1170,13 +1446,20 @@ namespace Stacker
 			return boardState;
 		}
 
+		// Bit i of row j is set if the cell at column i, row j is occupied.
+		const std::array<RowMask, Height> &GetRowMasks() const noexcept
+		{
+			return rowMasks;
+		}
+
 		const TetrominoState &GetTetrominoState() const noexcept
 		{
 			return currentTetrominoPositions;
 		}
 
-		const TetrominoState &GetGhostState() const noexcept
+		const TetrominoState &GetGhostState() const
 		{
+			UpdateDerivedState();
 			return currentGhostPositions;
 		}
 
@@ -1190,8 +1473,9 @@ namespace Stacker
 			return nextQueue;
 		}
 
-		const std::vector<int> &GetClearedRows() const noexcept
+		const SmallList<int, 4> &GetClearedRows() const
 		{
+			UpdateDerivedState();
 			return clearedRows;
 		}
 
@@ -1210,15 +1494,78 @@ namespace Stacker
 			return score;
 		}
 
+		usize GetStateVersion() const noexcept
+		{
+			return stateVersion;
+		}
+
+		// Same position, same hash: the occupied cells (not their types), the current piece type, hold, the next queue in order,
+		// b2b and combo. The piece's position, the bag and the score aren't part of it.
+		std::uint64_t GetHash() const noexcept
+		{
+			return hash;
+		}
+
+		// GetHash() worked out from scratch, what the incremental updates have to agree with.
+		std::uint64_t CalculateHash() const noexcept
+		{
+			std::uint64_t result = zobristKeys.activePiece[GetTetrominoIndex(GetTetrominoType())] ^ GetHeldPieceKey() ^ GetNextQueueKey() ^
+				GetStreakKey();
+
+			for (int row = 0; row < height; ++row)
+			{
+				result ^= GetRowKey(row, rowMasks[static_cast<usize>(row)]);
+			}
+
+			return result;
+		}
+
 		void SetGravityState(bool gravityState) noexcept
 		{
 			this->gravityState = gravityState;
 		}
 
+		// Replaces the whole playfield, keeping the current piece, the queues and the counters. Meant for tools and benchmarks.
+		void SetBoardState(const Matrix<TetrominoType> &boardState)
+		{
+			this->boardState = boardState;
+			RebuildMasks();
+			InvalidateDerivedState();
+			hash = CalculateHash();
+			MarkChanged();
+		}
+
+		bool IsPaused() const noexcept
+		{
+			return paused;
+		}
+
+		// Gravity, handling and fade timers are all frozen while paused.
+		void SetPaused(bool paused) noexcept
+		{
+			if (paused && !this->paused)
+			{
+				controller.ReleaseInputs();
+				gravityState = true;
+			}
+
+			if (paused != this->paused)
+			{
+				MarkChanged();
+			}
+
+			this->paused = paused;
+		}
+
+		void TogglePause() noexcept
+		{
+			SetPaused(!paused);
+		}
+
 		bool IsOccupied(int2 position) const noexcept
 		{
-			return position.x < 0 || position.x >= GetBoardSize().width || position.y < 0 || 
-				IsValidTetrominoType(boardState[int2{ position.y, position.x }]);
+			return position.x < 0 || position.x >= width || position.y < 0 || 
+				((rowMasks[static_cast<usize>(position.y)] >> position.x) & 1) != 0;
 		}
 
 		bool IsOccupied(const TetrominoState &tetrominoPositions) const noexcept
@@ -1239,24 +1586,31 @@ namespace Stacker
 			return !IsOccupied(currentTetrominoPositions + offset);
 		}
 
-		int SoftDropPiece(int steps) // positive Y steps here means down instead...
+		// Moves the current piece straight to a state, e.g. one a search found a way to, without going through the inputs.
+		// Does nothing and returns false if the state is occupied.
+		bool SetPieceState(const TetrominoState &tetrominoState, Orientation orientation)
 		{
-			int actualSteps = 0;
-
-			while (actualSteps != steps)
+			if (IsOccupied(tetrominoState))
 			{
-				++actualSteps;
-
-				if (IsOccupied(currentTetrominoPositions - int2 { 0, actualSteps }))
-				{
-					--actualSteps;
-					break;
-				}
+				return false;
 			}
 
+			currentTetrominoPositions = tetrominoState;
+			currentOrientation = orientation;
+			currentLineClearData.spinType = SpinType::None;
+			InvalidateDerivedState();
+			MarkChanged();
+			return true;
+		}
+
+		int SoftDropPiece(int steps) // positive Y steps here means down instead...
+		{
+			int actualSteps = steps > 0 ? std::min(steps, GetDropDistance()) : 0;
+
 			if (actualSteps != 0)
 			{
 				currentTetrominoPositions -= int2 { 0, actualSteps };
+				MarkChanged();
 			}
 
 			score += static_cast<usize>(actualSteps);
@@ -1265,13 +1619,24 @@ namespace Stacker
 
 		void LockAndMoveNext()
 		{
+			hash ^= GetStreakKey();
+
 			for (int2 pos : currentTetrominoPositions)
 			{
+				if (((rowMasks[static_cast<usize>(pos.y)] >> pos.x) & 1) == 0) // a piece that spawned into the stack overlaps it
+				{
+					hash ^= GetCellKey(pos.y, pos.x);
+				}
+
 				boardState[int2{ pos.y, pos.x }] = GetTetrominoType();
+				rowMasks[static_cast<usize>(pos.y)] |= static_cast<RowMask>(static_cast<RowMask>(1) << pos.x);
+				columnMasks[static_cast<usize>(pos.x)] |= static_cast<std::uint64_t>(1) << pos.y;
 			}
 
+			// the rows the locked piece actually fills, so locking never has to work out the ghost
+			std::uint64_t fullRows = Simd::FullRows(rowMasks.data(), Height, fullRowMask);
 			currentLineClearData.longB2bStreakBroken = false;
-			currentLineClearData.linesCleared = static_cast<int>(clearedRows.size());
+			currentLineClearData.linesCleared = std::popcount(fullRows);
 
 			if (currentLineClearData.linesCleared > 0)
 			{
@@ -1296,32 +1661,49 @@ namespace Stacker
 				currentLineClearData.combo = -1;
 			}
 
-			for (usize row = 0; row < 40; ++row)
+			if (fullRows != 0)
 			{
-				bool cleared = true;
+				int lowestClearedRow = std::countr_zero(fullRows); // rows below it don't move, so they keep their keys
+
+				for (int row = lowestClearedRow; row < height; ++row)
+				{
+					hash ^= GetRowKey(row, rowMasks[static_cast<usize>(row)]);
+				}
 
-				for (usize column = 0; column < 10; ++column)
+				boardState.ClearRowsWhere([fullRows](usize row) -> bool
 				{
-					if (!IsValidTetrominoType(boardState[usize2 { row, column }]))
+					return ((fullRows >> row) & 1) != 0;
+				});
+
+				usize kept = 0;
+
+				for (usize row = 0; row < Height; ++row)
+				{
+					if (((fullRows >> row) & 1) == 0)
 					{
-						cleared = false;
-						break;
+						rowMasks[kept] = rowMasks[row];
+						++kept;
 					}
 				}
 
-				if (cleared)
+				std::fill(rowMasks.begin() + static_cast<std::ptrdiff_t>(kept), rowMasks.end(), static_cast<RowMask>(0));
+
+				for (std::uint64_t &columnMask : columnMasks)
+				{
+					columnMask = Simd::RemoveBits(columnMask, fullRows);
+				}
+
+				for (int row = lowestClearedRow; row < height; ++row)
 				{
-					boardState.ClearRow(row);
-					boardState.MoveRowToLast(row);
-					--row;
+					hash ^= GetRowKey(row, rowMasks[static_cast<usize>(row)]);
 				}
 			}
 
-			currentLineClearData.isAllClear = boardState.IsCleared();
+			currentLineClearData.isAllClear = Simd::AllZero(rowMasks.data(), Height);
 
 			if (currentLineClearData.linesCleared > 0 || currentLineClearData.spinType != SpinType::None)
 			{
-				textFadeTimer = 0.0;
+				RestartTextFade();
 			}
 
 			if (currentLineClearData.IsB2bClear())
@@ -1405,14 +1787,15 @@ namespace Stacker
 				score += 3500;
 			}
 
-			currentTetromino = GetNext();
-			currentTetrominoPositions = currentTetromino.GetSpawnState();
-			currentGhostPositions = CalculateGhostPositions();
-			clearedRows = CalculateClearedLines();
+			SetCurrentTetromino(GetNext());
+			currentTetrominoPositions = GetSpawnState(currentTetromino);
+			InvalidateDerivedState();
 			currentOrientation = Orientation::North;
 			previousLineClearData = currentLineClearData;
 			currentLineClearData = LineClearData::New(previousLineClearData, GetTetrominoType());
+			hash ^= GetStreakKey();
 			gravityTimer.SetToMax();
+			MarkChanged();
 		}
 
 		void HardDropPiece() // A bit ironically, locking happens here
@@ -1428,36 +1811,42 @@ namespace Stacker
 			LockAndMoveNext();
 		}
 
-		void MovePiece(int maxMovement)
+		void MovePiece(int maxMovement) // an ARR of 0 passes int max here, which just means up to the wall
 		{
-			int step = SignOf(maxMovement);
 			int actualMovement = 0;
 
-			while (actualMovement != maxMovement && CanMove(int2 { actualMovement + step, 0 }))
+			if (maxMovement > 0)
+			{
+				actualMovement = std::min(maxMovement, GetMoveDistance(1));
+			}
+			else if (maxMovement < 0)
 			{
-				actualMovement += step;
+				actualMovement = std::max(maxMovement, -GetMoveDistance(-1));
 			}
 
-			currentTetrominoPositions += int2 { actualMovement, 0 };
-			currentGhostPositions = CalculateGhostPositions();
-			clearedRows = CalculateClearedLines();
+			if (actualMovement != 0)
+			{
+				currentTetrominoPositions += int2 { actualMovement, 0 };
+				InvalidateDerivedState();
+				MarkChanged();
+			}
 		}
 
 		void RotatePiece(RotateDirection rotateDirection)
 		{
 			Orientation newOrientation = RotateOrientation(currentOrientation, rotateDirection);
-			const std::vector<int2> &kicks = currentTetromino.kickTable.GetKicks(RotationChange { currentOrientation, rotateDirection });
-			int2 offset = currentTetrominoPositions - currentTetromino.kickTable.GetState(currentOrientation);
-			TetrominoState newPositions = currentTetromino.kickTable.GetState(newOrientation) + offset;
+			const KickList &kicks = currentTetromino.kickTable->GetKicks(RotationChange { currentOrientation, rotateDirection });
+			int2 offset = currentTetrominoPositions - currentTetromino.kickTable->GetState(currentOrientation);
+			TetrominoState newPositions = currentTetromino.kickTable->GetState(newOrientation) + offset;
 
 			for (int2 kickOffset : kicks)
 			{
 				if (!IsOccupied(newPositions + kickOffset))
 				{
 					currentTetrominoPositions = newPositions + kickOffset;
-					currentGhostPositions = CalculateGhostPositions();
-					clearedRows = CalculateClearedLines();
+					InvalidateDerivedState();
 					currentOrientation = newOrientation;
+					MarkChanged();
 
 					if ((!CanMove(int2{ 0, -1 })) && IsValidTetrominoType(GetTetrominoType()))
 					{
@@ -1535,42 +1924,48 @@ namespace Stacker
 
 		void HoldPiece()
 		{
+			hash ^= GetHeldPieceKey();
 			Nullable<Tetromino> heldTetromino = holdQueue.PopAndPush(currentTetromino);
+			hash ^= GetHeldPieceKey();
 
 			if (heldTetromino.HasValue())
 			{
-				currentTetromino = heldTetromino.Get();
+				SetCurrentTetromino(heldTetromino.Get());
 			}
 			else
 			{
-				currentTetromino = GetNext();
+				SetCurrentTetromino(GetNext());
 			}
 
-			currentTetrominoPositions = currentTetromino.GetSpawnState();
-			currentGhostPositions = CalculateGhostPositions();
-			clearedRows = CalculateClearedLines();
+			currentTetrominoPositions = GetSpawnState(currentTetromino);
+			InvalidateDerivedState();
 			currentOrientation = Orientation::North;
 			currentLineClearData.spinType = SpinType::None;
 			currentLineClearData.tetrominoType = GetTetrominoType();
 			gravityTimer.SetToMax();
+			MarkChanged();
 		}
 
 		void Reset()
 		{
 			boardState.Clear();
+			rowMasks.fill(0);
+			columnMasks.fill(0);
 			randomizer.Reset();
 			holdQueue.Reset();
 			nextQueue.Fill(randomizer);
 			currentTetromino = GetNext();
-			currentTetrominoPositions = currentTetromino.GetSpawnState();
-			currentGhostPositions = CalculateGhostPositions();
-			clearedRows = CalculateClearedLines();
+			currentTetrominoPositions = GetSpawnState(currentTetromino);
+			InvalidateDerivedState();
 			currentOrientation = Orientation::North;
 			gravityTimer.SetToMax();
 			previousLineClearData = LineClearData::Default();
 			currentLineClearData = LineClearData::New(GetTetrominoType());
 			score = 0;
-			textFadeTimer = 0.0;
+			RestartTextFade();
+			paused = false;
+			hash = CalculateHash();
+			MarkChanged();
 		}
 
 		void UpdateEvent(const SDL_Event &event) noexcept
@@ -1580,6 +1975,11 @@ namespace Stacker
 
 		void Update(DeltaTime deltaTime) noexcept
 		{
+			if (paused)
+			{
+				return;
+			}
+
 			if (gravityState)
 			{
 				if (CanMove(int2 { 0, -1 }))
@@ -1598,16 +1998,122 @@ namespace Stacker
 			}
 
 			controller.Update(deltaTime, *this);
+			tickRemainder += deltaTime;
+			Tick ticks = static_cast<Tick>(tickRemainder / tickTime);
+			tickRemainder -= static_cast<DeltaTime>(ticks) * tickTime;
+			timelines.Advance(ticks);
+		}
+	};
+
+	using Board = BasicBoard<10, 40>;
+
+	/// @brief A copy of everything drawing a board takes, so one thread can draw it while another keeps the board going.
+	/// Fixed size and free of heap memory, it's meant to be overwritten in place every tick.
+	template <const int Width, const int Height>
+	struct BasicBoardSnapshot final
+	{
+	public:
+		static constexpr int width = Width;
+		static constexpr int height = Height;
+		static constexpr usize maxNextCount = 8;
+
+		std::array<TetrominoType, static_cast<usize>(Width * Height)> cells; // row by row from the bottom, like the board
+		TetrominoState pieceState;
+		TetrominoState ghostState;
+		TetrominoState spawnState; // where the first next piece will appear
+		TetrominoState heldState; // spawn state relative to the hold queue, only meaningful if heldType is valid
+		std::array<TetrominoState, maxNextCount> nextStates; // the same, relative to each slot of the next queue
+		std::array<TetrominoType, maxNextCount> nextTypes;
+		TetrominoType pieceType;
+		TetrominoType heldType;
+		usize nextCount;
+		int nextBagIndex; // position of the first next piece in its bag, to draw the bag separators
+		int bagSize;
+		std::uint64_t clearedRows; // bit i is row i
+		LineClearData lineClearData;
+		usize score;
+		usize stateVersion;
+		Uint8 textAlpha;
+		bool paused;
+
+		TetrominoType GetCell(int row, int column) const noexcept
+		{
+			return cells[static_cast<usize>(row * Width + column)];
+		}
+
+		void Capture(const BasicBoard<Width, Height> &board)
+		{
+			const Matrix<TetrominoType> &boardState = board.GetBoardState();
+
+			for (int row = 0; row < Height; ++row)
+			{
+				for (int column = 0; column < Width; ++column)
+				{
+					cells[static_cast<usize>(row * Width + column)] = boardState[{ static_cast<usize>(row), static_cast<usize>(column) }];
+				}
+			}
+
+			pieceState = board.GetTetrominoState();
+			ghostState = board.GetGhostState();
+			pieceType = board.GetTetrominoType();
+			spawnState = board.GetSpawnState(*board.GetNextQueue().cbegin());
+			const Tetromino *heldPiece = board.GetHoldQueue().TryGet();
+			heldType = heldPiece != nullptr ? heldPiece->tetrominoType : TetrominoType::None;
+			heldState = heldPiece != nullptr ? heldPiece->kickTable->GetSpawnState() : TetrominoState();
+			nextCount = 0;
+
+			for (const Tetromino &tetromino : board.GetNextQueue())
+			{
+				if (nextCount == maxNextCount)
+				{
+					break;
+				}
+
+				nextStates[nextCount] = tetromino.kickTable->GetSpawnState();
+				nextTypes[nextCount] = tetromino.tetrominoType;
+				++nextCount;
+			}
+
+			bagSize = static_cast<int>(board.GetBagSize());
+			nextBagIndex = Mod(static_cast<int>(board.GetBagIndex()) - static_cast<int>(board.GetNextSize()), bagSize);
+			clearedRows = 0;
 
-			if (textFadeTimer < fullyFadedThreshold)
+			for (int row : board.GetClearedRows())
 			{
-				textFadeTimer += deltaTime;
+				clearedRows |= static_cast<std::uint64_t>(1) << row;
 			}
+
+			lineClearData = board.GetLineClearData();
+			score = board.GetScore();
+			stateVersion = board.GetStateVersion();
+			textAlpha = board.GetTextAlpha();
+			paused = board.IsPaused();
 		}
 	};
 
-	void Controller::UpdateEvent(const SDL_Event &event, Board &board) noexcept // TODO: Rewrite gravity support?
+	using BoardSnapshot = BasicBoardSnapshot<Board::width, Board::height>;
+
+	template <typename TBoard>
+	void Controller::UpdateEvent(const SDL_Event &event, TBoard &board) noexcept // TODO: Rewrite gravity support?
 	{
+		pauseInput.Update(event);
+
+		if (pauseInput.IsHeld() && (!pausePressed))
+		{
+			pausePressed = true;
+			board.TogglePause();
+		}
+
+		if (pauseInput.IsReleased())
+		{
+			pausePressed = false;
+		}
+
+		if (board.IsPaused())
+		{
+			return;
+		}
+
 		moveLeftInput.Update(event);
 		moveRightInput.Update(event);
 		rotateClockwiseInput.Update(event);
@@ -1779,7 +2285,8 @@ namespace Stacker
 		}
 	}
 
-	void Controller::Update(DeltaTime deltaTime, Board &board) noexcept
+	template <typename TBoard>
+	void Controller::Update(DeltaTime deltaTime, TBoard &board) noexcept
 	{
 		if (pressedSoftDropButton != SoftDropButton::None)
 		{
@@ -1860,69 +2367,80 @@ namespace Lib::Sdl
 			}
 		}
 
-		void RenderTo(SDL_Renderer *renderer, const Board &board, const std::unordered_map<TetrominoType, Texture> &tileTextures,
+		template <const int Width, const int Height>
+		void RenderTo(SDL_Renderer *renderer, const BasicBoardSnapshot<Width, Height> &board, const std::unordered_map<TetrominoType, Texture> &tileTextures,
 			const std::unordered_map<TetrominoType, Texture> &ghostTextures, const Texture &spawnTexture, const Texture &clearedTexture, 
 			const Texture &separatorTexture) const
 		{
-			RenderTo(renderer, board.GetBoardState(), tileTextures);
-			const TetrominoState &tetrominoState = board.GetTetrominoState();
-			const TetrominoState &ghostState = board.GetGhostState();
-			const Texture &tileTexture = tileTextures.at(board.GetTetrominoType());
-			const Texture &ghostTexture = ghostTextures.at(board.GetTetrominoType());
+			for (int row = 0; row < Height; ++row)
+			{
+				for (int column = 0; column < Width; ++column)
+				{
+					TetrominoType tetrominoType = board.GetCell(row, column);
+
+					if (IsValidTetrominoType(tetrominoType))
+					{
+						RenderTo(renderer, tileTextures.at(tetrominoType), nullptr, int2 { column, -row });
+					}
+				}
+			}
+
+			const Texture &tileTexture = tileTextures.at(board.pieceType);
+			const Texture &ghostTexture = ghostTextures.at(board.pieceType);
 			int2 nextOffset = nextQueueOffset;
-			int columns = board.GetBoardSize().width;
-			Nullable<Tetromino> heldPiece = board.GetHoldQueue().Get();
-			TetrominoState nextState = board.GetNextQueue().cbegin()->GetSpawnState();
 			
-			for (int2 position : ghostState)
+			for (int2 position : board.ghostState)
 			{
 				RenderTo(renderer, ghostTexture, nullptr, ReversedY(position));
 			}
 
-			for (int2 position : tetrominoState)
+			for (int2 position : board.pieceState)
 			{
 				RenderTo(renderer, tileTexture, nullptr, ReversedY(position));
 			}
 
-			for (int row : board.GetClearedRows())
+			for (int row = 0; row < Height; ++row)
 			{
-				for (int column = 0; column < columns; ++column)
+				if ((board.clearedRows >> row & 1) == 0)
 				{
-					RenderTo(renderer, clearedTexture, nullptr, int2{ static_cast<int>(column), -static_cast<int>(row) });
+					continue;
+				}
+
+				for (int column = 0; column < Width; ++column)
+				{
+					RenderTo(renderer, clearedTexture, nullptr, int2 { column, -row });
 				}
 			}
 
-			for (int2 position : nextState)
+			for (int2 position : board.spawnState)
 			{
 				RenderTo(renderer, spawnTexture, nullptr, ReversedY(position));
 			}
 
-			if (heldPiece.HasValue())
+			if (IsValidTetrominoType(board.heldType))
 			{
-				const Texture &heldPieceTexture = tileTextures.at(heldPiece->tetrominoType);
+				const Texture &heldPieceTexture = tileTextures.at(board.heldType);
 
-				for (int2 position : heldPiece.Get().kickTable.GetSpawnState())
+				for (int2 position : board.heldState)
 				{
 					SDL_Rect rect = Rect(Scale(ReversedY(position), tileSize) + holdQueueOffset, tileSize);
 					SDL_RenderCopy(renderer, heldPieceTexture, nullptr, &rect);
-					//RenderTo(renderer, tileTexture, nullptr, ReversedY(position));
 				}
 			}
 
-			int nextIndex = Mod(static_cast<int>(board.GetBagIndex()) - static_cast<int>(board.GetNextSize()), static_cast<int>(board.GetBagSize()));
+			int nextIndex = board.nextBagIndex;
 
-			for (const Tetromino &tetromino : board.GetNextQueue())
+			for (usize i = 0; i < board.nextCount; ++i)
 			{
-				TetrominoState state = tetromino.kickTable.GetSpawnState();
-				const Texture &texture = tileTextures.at(tetromino.tetrominoType);
+				const Texture &texture = tileTextures.at(board.nextTypes[i]);
 
-				for (int2 position : state)
+				for (int2 position : board.nextStates[i])
 				{
 					SDL_Rect rect = Rect(Scale(ReversedY(position), tileSize) + nextOffset, tileSize);
 					SDL_RenderCopy(renderer, texture, nullptr, &rect);
 				}
 
-				if (nextIndex + 1 >= static_cast<int>(board.GetBagSize()))
+				if (nextIndex + 1 >= board.bagSize)
 				{
 					SDL_Rect separatorRect = Rect(nextOffset + int2 { 0, 32 }, separatorTexture.GetSize());
 					SDL_RenderCopy(renderer, separatorTexture, nullptr, &separatorRect);
@@ -1933,6 +2451,17 @@ namespace Lib::Sdl
 				nextOffset.y += tileSize.height * 4;
 			}
 		}
+
+		// Draws straight from a live board, on the thread that owns it.
+		template <const int Width, const int Height>
+		void RenderTo(SDL_Renderer *renderer, const BasicBoard<Width, Height> &board, const std::unordered_map<TetrominoType, Texture> &tileTextures,
+			const std::unordered_map<TetrominoType, Texture> &ghostTextures, const Texture &spawnTexture, const Texture &clearedTexture, 
+			const Texture &separatorTexture) const
+		{
+			BasicBoardSnapshot<Width, Height> snapshot;
+			snapshot.Capture(board);
+			RenderTo(renderer, snapshot, tileTextures, ghostTextures, spawnTexture, clearedTexture, separatorTexture);
+		}
 	};
 
 	struct TextRenderGuide final
@@ -1949,7 +2478,21 @@ namespace Lib::Sdl
 			return origin;
 		}
 
-		void RenderTopRightAligned(SDL_Renderer *renderer, const Font &font, const string &text, SDL_Color color) const
+		void RenderTopLeftAligned(SDL_Renderer *renderer, const Font &font, const char *text, SDL_Color color) const
+		{
+			if (color.a > 0)
+			{
+				SDL_Rect rect = RectWithTopLeftPosition(origin, font.SizeUtf8(text));
+				font.RenderUtf8(text, color, renderer, nullptr, &rect);
+			}
+		}
+
+		void RenderTopLeftAligned(SDL_Renderer *renderer, const Font &font, const string &text, SDL_Color color) const
+		{
+			RenderTopLeftAligned(renderer, font, text.c_str(), color);
+		}
+
+		void RenderTopRightAligned(SDL_Renderer *renderer, const Font &font, const char *text, SDL_Color color) const
 		{
 			if (color.a > 0)
 			{
@@ -1958,7 +2501,12 @@ namespace Lib::Sdl
 			}
 		}
 
-		void RenderTopCenterAligned(SDL_Renderer *renderer, const Font &font, const string &text, SDL_Color color) const
+		void RenderTopRightAligned(SDL_Renderer *renderer, const Font &font, const string &text, SDL_Color color) const
+		{
+			RenderTopRightAligned(renderer, font, text.c_str(), color);
+		}
+
+		void RenderTopCenterAligned(SDL_Renderer *renderer, const Font &font, const char *text, SDL_Color color) const
 		{
 			if (color.a > 0)
 			{
@@ -1966,6 +2514,11 @@ namespace Lib::Sdl
 				font.RenderUtf8(text, color, renderer, nullptr, &rect);
 			}
 		}
+
+		void RenderTopCenterAligned(SDL_Renderer *renderer, const Font &font, const string &text, SDL_Color color) const
+		{
+			RenderTopCenterAligned(renderer, font, text.c_str(), color);
+		}
 	};
 }
 
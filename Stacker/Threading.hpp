@@ -0,0 +1,519 @@
+#ifndef THREADING_DEFINED
+#define THREADING_DEFINED
+
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <concepts>
+
+#include "Lib.hpp"
+#include "Collections.hpp"
+
+// A fixed set of worker threads shared by everything that wants to run in parallel, instead of each subsystem starting its own.
+// Work is split fork/join style: spawn tasks into a TaskGroup, then Sync() it, the waiting thread running tasks meanwhile.
+namespace Lib::Threading
+{
+	using namespace Lib;
+
+	class Scheduler;
+	class TaskGroup;
+
+	// For Spawn(), no preference on which worker runs the task
+	constexpr usize noAffinity = std::numeric_limits<usize>::max();
+
+	namespace Helpers
+	{
+		struct TaskBase
+		{
+		public:
+			using InvokeType = void(*)(TaskBase &task) noexcept;
+
+			InvokeType invoke;
+			TaskGroup *group;
+		};
+
+		template <typename TFunc>
+		struct FunctionTask final : TaskBase
+		{
+		public:
+			TFunc func;
+			bool owned; // allocated by TaskGroup::Spawn(), deleted once it ran
+
+			template <typename TValue>
+			FunctionTask(TValue &&func, bool owned) : TaskBase { &Invoke, nullptr }, func(std::forward<TValue>(func)), owned(owned) {}
+
+			static void Invoke(TaskBase &task) noexcept;
+		};
+
+		/// @brief The Chase-Lev deque: the owning worker pushes and pops at the bottom without contention, any other thread
+		/// steals from the top with a single CAS. Fixed capacity, a push that doesn't fit fails and the caller runs the task itself.
+		template <const usize Capacity> requires (Capacity > 0 && (Capacity & (Capacity - 1)) == 0)
+		class WorkDeque final
+		{
+		private:
+			static constexpr isize mask = static_cast<isize>(Capacity - 1);
+
+			alignas(Collections::cacheLineSize) std::atomic<isize> top; // next to steal
+			alignas(Collections::cacheLineSize) std::atomic<isize> bottom; // next to push, only the owner writes it
+			alignas(Collections::cacheLineSize) std::array<std::atomic<TaskBase *>, Capacity> tasks;
+
+		public:
+			WorkDeque() noexcept : top(0), bottom(0), tasks() {}
+
+			WorkDeque(const WorkDeque &) = delete;
+			WorkDeque &operator=(const WorkDeque &) = delete;
+
+			// Owner only
+			bool TryPush(TaskBase *task) noexcept
+			{
+				isize index = bottom.load(std::memory_order_relaxed);
+
+				if (index - top.load(std::memory_order_acquire) >= static_cast<isize>(Capacity))
+				{
+					return false;
+				}
+
+				tasks[static_cast<usize>(index & mask)].store(task, std::memory_order_relaxed);
+				bottom.store(index + 1, std::memory_order_release);
+				return true;
+			}
+
+			// Owner only, newest first
+			TaskBase *TryPop() noexcept
+			{
+				isize index = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(index, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst); // the store above has to be seen before top is read
+				isize first = top.load(std::memory_order_relaxed);
+
+				if (first > index) // was empty
+				{
+					bottom.store(index + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+
+				TaskBase *result = tasks[static_cast<usize>(index & mask)].load(std::memory_order_relaxed);
+
+				if (first == index) // the last one, thieves might be after it too
+				{
+					if (!top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					{
+						result = nullptr;
+					}
+
+					bottom.store(index + 1, std::memory_order_relaxed);
+				}
+
+				return result;
+			}
+
+			// Any thread, oldest first, which for recursive splitting is also the biggest piece
+			TaskBase *TrySteal() noexcept
+			{
+				isize first = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				isize end = bottom.load(std::memory_order_acquire);
+
+				if (first >= end)
+				{
+					return nullptr;
+				}
+
+				TaskBase *result = tasks[static_cast<usize>(first & mask)].load(std::memory_order_relaxed);
+				return top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst, std::memory_order_relaxed) ? result : nullptr;
+			}
+
+			bool IsEmpty() const noexcept
+			{
+				return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+			}
+		};
+	}
+
+	/// @brief Tracks a batch of spawned tasks so they can be waited on together. Sync() (also run by the destructor) doesn't
+	/// block while there's anything to do: the calling thread runs queued tasks, its own or anyone's, until the batch is done.
+	class TaskGroup final
+	{
+	private:
+		Scheduler *scheduler;
+		std::atomic<usize> pending;
+
+		template <typename TFunc>
+		friend struct Helpers::FunctionTask;
+
+		void Finish() noexcept
+		{
+			pending.fetch_sub(1, std::memory_order_release);
+		}
+
+	public:
+		explicit TaskGroup(Scheduler &scheduler) noexcept : scheduler(std::addressof(scheduler)), pending(0) {}
+
+		TaskGroup(const TaskGroup &) = delete;
+		TaskGroup &operator=(const TaskGroup &) = delete;
+
+		~TaskGroup()
+		{
+			Sync();
+		}
+
+		Scheduler &GetScheduler() const noexcept
+		{
+			return *scheduler;
+		}
+
+		/// @brief Queues func to run on some thread of the scheduler, allocating a small task for it.
+		/// @param affinity A worker index (see Scheduler::GetCurrentWorkerIndex()) the task would best run on, e.g. for cache warmth.
+		/// It's only a hint, idle workers will still steal it.
+		template <typename TFunc> requires std::invocable<std::decay_t<TFunc> &>
+		void Spawn(TFunc &&func, usize affinity = noAffinity);
+
+		/// @brief Queues a task the caller owns, which saves the allocation as long as it outlives Sync().
+		void Spawn(Helpers::TaskBase &task, usize affinity = noAffinity);
+
+		void Sync() noexcept;
+	};
+
+	class Scheduler final
+	{
+	private:
+		static constexpr usize dequeCapacity = 1024;
+		static constexpr int spinCount = 64; // tries before an idle worker goes to sleep
+
+		struct Worker final
+		{
+		public:
+			Helpers::WorkDeque<dequeCapacity> deque;
+			std::mutex inboxMutex;
+			std::deque<Helpers::TaskBase *> inbox; // tasks pushed from other threads, or with this worker as their affinity
+			std::atomic<usize> inboxCount;
+			std::thread thread;
+
+			Worker() : deque(), inboxMutex(), inbox(), inboxCount(0), thread() {}
+		};
+
+		inline static thread_local Scheduler *currentScheduler = nullptr;
+		inline static thread_local usize currentWorkerIndex = noAffinity;
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic<std::uint32_t> workEpoch; // bumped on every push, what idle workers sleep on
+		std::atomic<usize> sleepingCount;
+		std::atomic<usize> nextInbox;
+		std::atomic<bool> stopping;
+
+		void PushToInbox(Worker &worker, Helpers::TaskBase *task)
+		{
+			std::lock_guard<std::mutex> lock = std::lock_guard<std::mutex>(worker.inboxMutex);
+			worker.inbox.push_back(task);
+			worker.inboxCount.fetch_add(1, std::memory_order_release);
+		}
+
+		static Helpers::TaskBase *TryPopInbox(Worker &worker)
+		{
+			if (worker.inboxCount.load(std::memory_order_acquire) == 0)
+			{
+				return nullptr;
+			}
+
+			std::lock_guard<std::mutex> lock = std::lock_guard<std::mutex>(worker.inboxMutex);
+
+			if (worker.inbox.empty())
+			{
+				return nullptr;
+			}
+
+			Helpers::TaskBase *result = worker.inbox.front();
+			worker.inbox.pop_front();
+			worker.inboxCount.fetch_sub(1, std::memory_order_relaxed);
+			return result;
+		}
+
+		void WakeOne() noexcept
+		{
+			workEpoch.fetch_add(1, std::memory_order_seq_cst);
+
+			if (sleepingCount.load(std::memory_order_seq_cst) > 0)
+			{
+				workEpoch.notify_one();
+			}
+		}
+
+		// Own inbox first (that's where affinity hints land), then own deque, then everyone else's, starting after self
+		// so thieves spread out.
+		Helpers::TaskBase *FindTask(usize self)
+		{
+			usize workerCount = workers.size();
+			usize start = self != noAffinity ? self : 0;
+
+			if (self != noAffinity)
+			{
+				if (Helpers::TaskBase *task = TryPopInbox(*workers[self]))
+				{
+					return task;
+				}
+
+				if (Helpers::TaskBase *task = workers[self]->deque.TryPop())
+				{
+					return task;
+				}
+			}
+
+			for (usize i = 0; i < workerCount; ++i)
+			{
+				usize victim = (start + i) % workerCount;
+
+				if (victim != self)
+				{
+					if (Helpers::TaskBase *task = workers[victim]->deque.TrySteal())
+					{
+						return task;
+					}
+				}
+			}
+
+			for (usize i = 0; i < workerCount; ++i)
+			{
+				usize victim = (start + i) % workerCount;
+
+				if (victim != self)
+				{
+					if (Helpers::TaskBase *task = TryPopInbox(*workers[victim]))
+					{
+						return task;
+					}
+				}
+			}
+
+			return nullptr;
+		}
+
+		void RunWorker(usize index) noexcept
+		{
+			currentScheduler = this;
+			currentWorkerIndex = index;
+			int idleSpins = 0;
+
+			while (true)
+			{
+				std::uint32_t epoch = workEpoch.load(std::memory_order_seq_cst);
+
+				if (Helpers::TaskBase *task = FindTask(index))
+				{
+					task->invoke(*task);
+					idleSpins = 0;
+				}
+				else if (stopping.load(std::memory_order_acquire))
+				{
+					break;
+				}
+				else if (++idleSpins < spinCount)
+				{
+					std::this_thread::yield();
+				}
+				else
+				{
+					// Anything pushed since epoch was read changed it, so this can't sleep through new work
+					sleepingCount.fetch_add(1, std::memory_order_seq_cst);
+					workEpoch.wait(epoch, std::memory_order_seq_cst);
+					sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+					idleSpins = 0;
+				}
+			}
+
+			currentScheduler = nullptr;
+			currentWorkerIndex = noAffinity;
+		}
+
+		friend class TaskGroup;
+
+		void Push(Helpers::TaskBase &task, usize affinity)
+		{
+			if (workers.empty())
+			{
+				task.invoke(task);
+				return;
+			}
+
+			if (affinity != noAffinity)
+			{
+				PushToInbox(*workers[affinity % workers.size()], std::addressof(task));
+			}
+			else if (currentScheduler == this)
+			{
+				if (!workers[currentWorkerIndex]->deque.TryPush(std::addressof(task)))
+				{
+					task.invoke(task); // deep enough already, no point queueing more
+					return;
+				}
+			}
+			else
+			{
+				PushToInbox(*workers[nextInbox.fetch_add(1, std::memory_order_relaxed) % workers.size()], std::addressof(task));
+			}
+
+			WakeOne();
+		}
+
+		// One task from anywhere for a thread waiting on a TaskGroup, null if there's nothing to do right now
+		Helpers::TaskBase *FindTaskForCurrentThread()
+		{
+			return FindTask(currentScheduler == this ? currentWorkerIndex : noAffinity);
+		}
+
+	public:
+		/// @param workerCount 0 makes a scheduler that runs everything on the spawning thread, handy for deterministic runs
+		explicit Scheduler(usize workerCount) : workers(), workEpoch(0), sleepingCount(0), nextInbox(0), stopping(false)
+		{
+			workers.reserve(workerCount);
+
+			for (usize i = 0; i < workerCount; ++i)
+			{
+				workers.push_back(std::make_unique<Worker>());
+			}
+
+			// only once they all exist, since every worker may steal from every other one
+			for (usize i = 0; i < workerCount; ++i)
+			{
+				workers[i]->thread = std::thread([this, i]() -> void { RunWorker(i); });
+			}
+		}
+
+		Scheduler(const Scheduler &) = delete;
+		Scheduler &operator=(const Scheduler &) = delete;
+
+		// Runs whatever is still queued, then joins the workers.
+		~Scheduler()
+		{
+			stopping.store(true, std::memory_order_release);
+			workEpoch.fetch_add(1, std::memory_order_seq_cst);
+			workEpoch.notify_all();
+
+			for (std::unique_ptr<Worker> &worker : workers)
+			{
+				worker->thread.join();
+			}
+		}
+
+		/// @brief The one every subsystem should use unless it has a reason not to. One worker less than there are hardware
+		/// threads, since whoever waits on a TaskGroup works too.
+		static Scheduler &GetShared()
+		{
+			static Scheduler shared = Scheduler(std::max(static_cast<usize>(std::thread::hardware_concurrency()), static_cast<usize>(2)) - 1);
+			return shared;
+		}
+
+		usize GetWorkerCount() const noexcept
+		{
+			return workers.size();
+		}
+
+		// How many threads can be running tasks at once: the workers and the one waiting
+		usize GetConcurrency() const noexcept
+		{
+			return workers.size() + 1;
+		}
+
+		// Index of the calling worker of this scheduler, noAffinity for any other thread
+		usize GetCurrentWorkerIndex() const noexcept
+		{
+			return currentScheduler == this ? currentWorkerIndex : noAffinity;
+		}
+	};
+
+	template <typename TFunc>
+	void Helpers::FunctionTask<TFunc>::Invoke(TaskBase &task) noexcept
+	{
+		FunctionTask &self = static_cast<FunctionTask &>(task);
+		TaskGroup *group = self.group; // self may be gone by the time the group hears about it
+		self.func();
+
+		if (self.owned)
+		{
+			delete std::addressof(self);
+		}
+
+		group->Finish();
+	}
+
+	template <typename TFunc> requires std::invocable<std::decay_t<TFunc> &>
+	void TaskGroup::Spawn(TFunc &&func, usize affinity)
+	{
+		using TaskType = Helpers::FunctionTask<std::decay_t<TFunc>>;
+		TaskType *task = new TaskType(std::forward<TFunc>(func), true);
+		Spawn(*task, affinity);
+	}
+
+	inline void TaskGroup::Spawn(Helpers::TaskBase &task, usize affinity)
+	{
+		task.group = this;
+		pending.fetch_add(1, std::memory_order_relaxed);
+		scheduler->Push(task, affinity);
+	}
+
+	inline void TaskGroup::Sync() noexcept
+	{
+		while (pending.load(std::memory_order_acquire) != 0)
+		{
+			if (Helpers::TaskBase *task = scheduler->FindTaskForCurrentThread())
+			{
+				task->invoke(*task);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	/// @brief Calls func(first, last) on consecutive subranges of [begin, end) covering all of it, in parallel. The range is halved
+	/// until the pieces are at most grainSize long, each half being left for idle workers to steal, so uneven work balances itself.
+	/// Returns once every piece is done.
+	template <typename TFunc>
+	void ParallelForRange(Scheduler &scheduler, usize begin, usize end, usize grainSize, TFunc &&func)
+	{
+		grainSize = std::max(grainSize, static_cast<usize>(1));
+
+		if (end <= begin)
+		{
+			return;
+		}
+
+		if (end - begin <= grainSize || scheduler.GetWorkerCount() == 0)
+		{
+			func(begin, end);
+			return;
+		}
+
+		usize middle = begin + (end - begin) / 2;
+		TaskGroup group = TaskGroup(scheduler);
+		auto upperHalf = [&]() -> void { ParallelForRange(scheduler, middle, end, grainSize, func); };
+		Helpers::FunctionTask<decltype(upperHalf)> task = Helpers::FunctionTask<decltype(upperHalf)>(upperHalf, false);
+		group.Spawn(task);
+		ParallelForRange(scheduler, begin, middle, grainSize, func);
+		group.Sync();
+	}
+
+	/// @brief Calls func(i) for every i in [begin, end), in parallel, in grainSize long runs at least.
+	template <typename TFunc>
+	void ParallelFor(Scheduler &scheduler, usize begin, usize end, TFunc &&func, usize grainSize = 1)
+	{
+		ParallelForRange(scheduler, begin, end, grainSize, [&](usize first, usize last) -> void
+		{
+			for (usize i = first; i < last; ++i)
+			{
+				func(i);
+			}
+		});
+	}
+}
+
+#endif // !THREADING_DEFINED
@@ -5,6 +5,12 @@
 
 #include <ctime>
 #include <chrono>
+#include <array>
+#include <vector>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
 
 #include "Lib.hpp"
 
@@ -17,6 +23,8 @@ namespace Lib::Time
 {
 	using namespace Lib;
 
+	using Tick = std::uint64_t; // a step of whatever fixed-step loop drives the timers, its length is up to that loop
+
 	struct StdTimer final
 	{
 	private:
@@ -64,6 +72,12 @@ namespace Lib::Time
 
 		constexpr int Update(DeltaTime deltaTime) noexcept
 		{
+			if (maxTime <= DeltaTime()) // an instant timer, as many steps as the caller can take
+			{
+				currentTime = DeltaTime();
+				return std::numeric_limits<int>::max();
+			}
+
 			DeltaTime addedTime = currentTime + deltaTime;
 			DeltaTime temp = addedTime / maxTime;
 
@@ -165,6 +179,12 @@ namespace Lib::Time
 
 			if (IsChargingArr())
 			{
+				if (arrTime <= DeltaTime()) // ARR 0, straight to the wall
+				{
+					time = DeltaTime();
+					return std::numeric_limits<int>::max();
+				}
+
 				DeltaTime steps = addedTime / arrTime;
 
 				if (steps > static_cast<DeltaTime>(std::numeric_limits<int>::max()))
@@ -180,6 +200,13 @@ namespace Lib::Time
 			}
 			else
 			{
+				if (dasTime <= DeltaTime())
+				{
+					time = DeltaTime();
+					++dasTicks;
+					return 1;
+				}
+
 				DeltaTime steps = addedTime / dasTime;
 
 				if (steps > static_cast<DeltaTime>(std::numeric_limits<int>::max()))
@@ -201,6 +228,228 @@ namespace Lib::Time
 			}
 		}
 	};
+
+	// Names a timer scheduled on a TimerWheel, stays safe to use (and simply stops matching anything) once it expired or was cancelled.
+	struct TimerId final
+	{
+	public:
+		std::uint32_t index;
+		std::uint32_t generation;
+
+		static constexpr TimerId None() noexcept
+		{
+			return TimerId { std::numeric_limits<std::uint32_t>::max(), 0 };
+		}
+
+		constexpr bool operator==(const TimerId &other) const noexcept = default;
+	};
+
+	/// @brief A hashed timer wheel: every timer sits in the bucket its expiry tick hashes to, in an intrusive list, so scheduling and
+	/// cancelling are O(1) whatever the delay. Advancing skips empty buckets through an occupancy bitmap and only walks the ones due,
+	/// where timers that are whole turns of the wheel away are passed over until their turn. Timers due on the same tick expire in
+	/// the order they were scheduled. Not thread-safe.
+	template <typename TPayload, const usize Buckets = 256> requires (Buckets >= 64 && (Buckets & (Buckets - 1)) == 0)
+	class TimerWheel final
+	{
+	private:
+		static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+		static constexpr usize mask = Buckets - 1;
+		static constexpr std::uint32_t expiringList = static_cast<std::uint32_t>(Buckets); // due this tick, still cancellable until they run
+
+		struct Node final
+		{
+		public:
+			TPayload payload;
+			Tick expiry;
+			std::uint32_t previous;
+			std::uint32_t next; // also links the free nodes
+			std::uint32_t generation;
+			std::uint32_t list; // a bucket, expiringList, or none while free
+		};
+
+		struct List final
+		{
+		public:
+			std::uint32_t head;
+			std::uint32_t tail;
+		};
+
+		std::vector<Node> nodes;
+		std::uint32_t freeNodes;
+		std::array<List, Buckets + 1> lists; // the buckets, then the expiring list
+		std::array<std::uint64_t, Buckets / 64> occupied; // bit i is set if bucket i isn't empty
+		Tick now;
+		usize count;
+
+		void Append(std::uint32_t listIndex, std::uint32_t index) noexcept
+		{
+			List &list = lists[listIndex];
+			Node &node = nodes[index];
+			node.list = listIndex;
+			node.previous = list.tail;
+			node.next = none;
+			(list.tail != none ? nodes[list.tail].next : list.head) = index;
+			list.tail = index;
+
+			if (listIndex != expiringList)
+			{
+				occupied[listIndex / 64] |= static_cast<std::uint64_t>(1) << (listIndex % 64);
+			}
+		}
+
+		void Unlink(std::uint32_t index) noexcept
+		{
+			Node &node = nodes[index];
+			List &list = lists[node.list];
+			(node.previous != none ? nodes[node.previous].next : list.head) = node.next;
+			(node.next != none ? nodes[node.next].previous : list.tail) = node.previous;
+
+			if (list.head == none && node.list != expiringList)
+			{
+				occupied[node.list / 64] &= ~(static_cast<std::uint64_t>(1) << (node.list % 64));
+			}
+		}
+
+		void Free(std::uint32_t index) noexcept
+		{
+			Node &node = nodes[index];
+			node.list = none;
+			++node.generation;
+			node.next = freeNodes;
+			freeNodes = index;
+			--count;
+		}
+
+		// The first tick in [from, to] whose bucket has anything in it, or to + 1. Looks at most one turn ahead, since every bucket
+		// comes up once in a turn.
+		Tick FindOccupiedTick(Tick from, Tick to) const noexcept
+		{
+			usize start = static_cast<usize>(from & mask);
+			Tick limit = std::min(to - from, static_cast<Tick>(Buckets - 1));
+			Tick offset = 0;
+
+			while (offset <= limit)
+			{
+				usize bucket = static_cast<usize>((start + offset) & mask);
+				std::uint64_t bits = occupied[bucket / 64] >> (bucket % 64);
+
+				if (bits != 0)
+				{
+					Tick found = offset + static_cast<Tick>(std::countr_zero(bits));
+					return found <= limit ? from + found : to + 1;
+				}
+
+				offset += 64 - bucket % 64;
+			}
+
+			return to + 1;
+		}
+
+	public:
+		using payload_type = TPayload;
+
+		TimerWheel() : nodes(), freeNodes(none), lists(), occupied(), now(0), count(0)
+		{
+			lists.fill(List { none, none });
+		}
+
+		Tick GetTick() const noexcept
+		{
+			return now;
+		}
+
+		usize size() const noexcept
+		{
+			return count;
+		}
+
+		bool IsPending(TimerId id) const noexcept
+		{
+			return id.index < nodes.size() && nodes[id.index].generation == id.generation && nodes[id.index].list != none;
+		}
+
+		/// @brief Expires delay ticks from now, a delay of 0 meaning the next tick like 1 does.
+		TimerId Schedule(Tick delay, const TPayload &payload)
+		{
+			std::uint32_t index = freeNodes;
+
+			if (index != none)
+			{
+				freeNodes = nodes[index].next;
+				nodes[index].payload = payload;
+			}
+			else
+			{
+				index = static_cast<std::uint32_t>(nodes.size());
+				nodes.push_back(Node { payload, 0, none, none, 0, none });
+			}
+
+			Tick expiry = now + std::max(delay, static_cast<Tick>(1));
+			nodes[index].expiry = expiry;
+			Append(static_cast<std::uint32_t>(expiry & mask), index);
+			++count;
+			return TimerId { index, nodes[index].generation };
+		}
+
+		/// @return Whether it was still pending
+		bool Cancel(TimerId id) noexcept
+		{
+			if (!IsPending(id))
+			{
+				return false;
+			}
+
+			Unlink(id.index);
+			Free(id.index);
+			return true;
+		}
+
+		/// @brief Moves time forward tick by tick, calling onExpired(payload) for every timer on the tick it expires, with GetTick()
+		/// being that tick. onExpired may schedule and cancel timers itself, including ones due on the same tick.
+		template <typename TFunc>
+		void Advance(Tick ticks, TFunc &&onExpired)
+		{
+			Tick target = now + ticks;
+
+			while (now < target && count > 0)
+			{
+				Tick tick = FindOccupiedTick(now + 1, target);
+
+				if (tick > target)
+				{
+					break;
+				}
+
+				now = tick;
+				List &bucket = lists[static_cast<usize>(tick & mask)];
+
+				// moved out first, so the callbacks can't disturb the walk
+				for (std::uint32_t index = bucket.head; index != none;)
+				{
+					std::uint32_t next = nodes[index].next;
+
+					if (nodes[index].expiry == tick)
+					{
+						Unlink(index);
+						Append(expiringList, index);
+					}
+
+					index = next;
+				}
+
+				while (lists[expiringList].head != none)
+				{
+					std::uint32_t index = lists[expiringList].head;
+					TPayload payload = nodes[index].payload;
+					Unlink(index);
+					Free(index);
+					onExpired(payload);
+				}
+			}
+
+			now = target;
+		}
+	};
 }
 
 #endif // !TIME_DEFINED
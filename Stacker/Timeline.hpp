@@ -0,0 +1,373 @@
+#ifndef TIMELINE_DEFINED
+#define TIMELINE_DEFINED
+
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <exception>
+
+#include "Lib.hpp"
+#include "Time.hpp"
+#include "Memory.hpp"
+
+// Effects and delays written as straight-line code instead of timers and thresholds:
+//
+//     Timeline Flash(TimelineScheduler &timelines, Board &board)
+//     {
+//         board.SetHighlight(true);
+//         co_await Ticks(50);
+//         board.SetHighlight(false);
+//     }
+//
+//     TimelineId flash = timelines.Start(Flash(timelines, board));
+//
+// Time only moves when the owner calls TimelineScheduler::Advance() from its fixed-step tick, and a waiting timeline costs nothing
+// until the tick it waits for comes around.
+namespace Lib::Time
+{
+	using namespace Lib;
+
+	class TimelineScheduler;
+
+	// Names a started timeline, stays safe to use (and simply stops matching anything) once the timeline is over.
+	struct TimelineId final
+	{
+	public:
+		usize slot;
+		usize generation;
+
+		static constexpr TimelineId None() noexcept
+		{
+			return TimelineId { static_cast<usize>(-1), 0 };
+		}
+
+		constexpr bool operator==(const TimelineId &other) const noexcept = default;
+	};
+
+	namespace Helpers
+	{
+		// In front of every coroutine frame, so operator delete (which only gets the pointer and size) knows where it came from
+		struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) FrameHeader final
+		{
+		public:
+			Memory::Allocation::FixedPool *pool; // null for frames from the global heap
+		};
+	}
+
+	/// @brief The return type of a timeline coroutine. Does nothing until handed to TimelineScheduler::Start(), which takes it over.
+	/// Coroutines whose first parameter is the scheduler (the second one, for member functions) get their frame from its pools
+	/// instead of the global heap.
+	class Timeline final
+	{
+	public:
+		struct promise_type final
+		{
+		public:
+			TimelineScheduler *scheduler = nullptr;
+			usize slot = 0;
+
+			Timeline get_return_object() noexcept
+			{
+				return Timeline(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			std::suspend_always initial_suspend() const noexcept
+			{
+				return std::suspend_always();
+			}
+
+			// The scheduler destroys the frame once it sees it's done
+			std::suspend_always final_suspend() const noexcept
+			{
+				return std::suspend_always();
+			}
+
+			void return_void() const noexcept {}
+
+			void unhandled_exception() const noexcept
+			{
+				std::terminate(); // there's nobody to rethrow it to
+			}
+
+			template <typename ...TParams>
+			static void *operator new(usize size, TimelineScheduler &scheduler, TParams &...);
+
+			template <typename TOwner, typename ...TParams>
+			static void *operator new(usize size, TOwner &, TimelineScheduler &scheduler, TParams &...);
+
+			static void *operator new(usize size);
+			static void operator delete(void *frame, usize size) noexcept;
+		};
+
+		using Handle = std::coroutine_handle<promise_type>;
+
+	private:
+		Handle handle;
+
+		explicit Timeline(Handle handle) noexcept : handle(handle) {}
+
+		friend class TimelineScheduler;
+
+	public:
+		Timeline(const Timeline &) = delete;
+		Timeline &operator=(const Timeline &) = delete;
+
+		Timeline(Timeline &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+		Timeline &operator=(Timeline &&other) noexcept
+		{
+			if (this != std::addressof(other))
+			{
+				if (handle)
+				{
+					handle.destroy();
+				}
+
+				handle = std::exchange(other.handle, nullptr);
+			}
+
+			return *this;
+		}
+
+		// Only still owned if it was never started
+		~Timeline()
+		{
+			if (handle)
+			{
+				handle.destroy();
+			}
+		}
+	};
+
+	/// @brief Runs timelines against a tick counter only it advances. Waiting timelines sit in a TimerWheel, so a wait or a cancel is
+	/// O(1) and Advance() only ever touches the ones that are due. Ties wake in the order they went to sleep. Not thread-safe,
+	/// every timeline runs on the thread calling Advance() (or Start()).
+	class TimelineScheduler final
+	{
+	private:
+		static constexpr usize frameSizeClasses = 4;
+		static constexpr usize smallestFrameSize = 128; // header included, doubling from there
+		static constexpr usize framesPerChunk = 64;
+
+		struct Slot final
+		{
+		public:
+			Timeline::Handle handle; // null while the slot is free
+			usize generation;
+			TimerId wake; // while it waits
+		};
+
+		std::array<Memory::Allocation::FixedPool, frameSizeClasses> framePools;
+		std::vector<Slot> slots;
+		std::vector<usize> freeSlots;
+		TimerWheel<usize> sleeping; // the slots of the waiting timelines
+		usize runningCount;
+
+		void Release(usize slot) noexcept
+		{
+			sleeping.Cancel(slots[slot].wake);
+			slots[slot].wake = TimerId::None();
+			slots[slot].handle.destroy();
+			slots[slot].handle = nullptr;
+			++slots[slot].generation;
+			freeSlots.push_back(slot);
+			--runningCount;
+		}
+
+		void Resume(usize slot)
+		{
+			Timeline::Handle handle = slots[slot].handle;
+			handle.resume();
+
+			if (handle.done())
+			{
+				Release(slot);
+			}
+		}
+
+		friend struct Ticks;
+		friend struct Timeline::promise_type;
+
+		void Sleep(const Timeline::promise_type &promise, Tick ticks)
+		{
+			slots[promise.slot].wake = sleeping.Schedule(ticks, promise.slot);
+		}
+
+		void *AllocateFrame(usize size)
+		{
+			usize classSize = smallestFrameSize;
+
+			for (Memory::Allocation::FixedPool &pool : framePools)
+			{
+				if (size + sizeof(Helpers::FrameHeader) <= classSize)
+				{
+					Helpers::FrameHeader *header = new (pool.Allocate()) Helpers::FrameHeader { std::addressof(pool) };
+					return header + 1;
+				}
+
+				classSize *= 2;
+			}
+
+			return AllocateUnpooledFrame(size);
+		}
+
+		static void *AllocateUnpooledFrame(usize size)
+		{
+			Helpers::FrameHeader *header = new (::operator new(size + sizeof(Helpers::FrameHeader))) Helpers::FrameHeader { nullptr };
+			return header + 1;
+		}
+
+		static void DeallocateFrame(void *frame) noexcept
+		{
+			Helpers::FrameHeader *header = static_cast<Helpers::FrameHeader *>(frame) - 1;
+
+			if (header->pool != nullptr)
+			{
+				header->pool->Deallocate(header);
+			}
+			else
+			{
+				::operator delete(header);
+			}
+		}
+
+	public:
+		TimelineScheduler() : framePools
+			{
+				Memory::Allocation::FixedPool(smallestFrameSize, __STDCPP_DEFAULT_NEW_ALIGNMENT__, framesPerChunk),
+				Memory::Allocation::FixedPool(smallestFrameSize * 2, __STDCPP_DEFAULT_NEW_ALIGNMENT__, framesPerChunk),
+				Memory::Allocation::FixedPool(smallestFrameSize * 4, __STDCPP_DEFAULT_NEW_ALIGNMENT__, framesPerChunk),
+				Memory::Allocation::FixedPool(smallestFrameSize * 8, __STDCPP_DEFAULT_NEW_ALIGNMENT__, framesPerChunk),
+			}, slots(), freeSlots(), sleeping(), runningCount(0) {}
+
+		// Timelines keep pointers to it (and usually to its owner), so it stays put
+		TimelineScheduler(const TimelineScheduler &) = delete;
+		TimelineScheduler &operator=(const TimelineScheduler &) = delete;
+
+		// Whatever is still running is destroyed where it waits
+		~TimelineScheduler()
+		{
+			for (Slot &slot : slots)
+			{
+				if (slot.handle)
+				{
+					slot.handle.destroy();
+				}
+			}
+		}
+
+		Tick GetTick() const noexcept
+		{
+			return sleeping.GetTick();
+		}
+
+		usize GetRunningCount() const noexcept
+		{
+			return runningCount;
+		}
+
+		bool IsRunning(TimelineId id) const noexcept
+		{
+			return id.slot < slots.size() && slots[id.slot].generation == id.generation && slots[id.slot].handle;
+		}
+
+		/// @brief Takes the timeline over and runs it right away, up to its first wait.
+		/// @return TimelineId::None() if it already finished, since there's nothing left to refer to
+		TimelineId Start(Timeline &&timeline)
+		{
+			usize slot = 0;
+
+			if (!freeSlots.empty())
+			{
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			else
+			{
+				slot = slots.size();
+				slots.push_back(Slot { nullptr, 0, TimerId::None() });
+			}
+
+			Timeline::Handle handle = std::exchange(timeline.handle, nullptr);
+			handle.promise().scheduler = this;
+			handle.promise().slot = slot;
+			slots[slot].handle = handle;
+			++runningCount;
+			TimelineId id = TimelineId { slot, slots[slot].generation };
+			Resume(slot);
+			return IsRunning(id) ? id : TimelineId::None();
+		}
+
+		/// @brief Destroys the timeline where it waits, running the destructors of its locals. Not for a timeline to cancel itself.
+		/// @return Whether it was still running
+		bool Cancel(TimelineId id) noexcept
+		{
+			if (!IsRunning(id))
+			{
+				return false;
+			}
+
+			Release(id.slot);
+			return true;
+		}
+
+		/// @brief Moves time forward, resuming every timeline whose wait ends on the way, in tick order. A timeline waiting again
+		/// counts from the tick it woke on, so waits inside one Advance(n) add up exactly.
+		void Advance(Tick ticks = 1)
+		{
+			sleeping.Advance(ticks, [&](usize slot) -> void
+			{
+				slots[slot].wake = TimerId::None();
+				Resume(slot);
+			});
+		}
+	};
+
+	/// @brief co_await Ticks(n) inside a timeline to carry on n ticks later, 0 doesn't wait at all.
+	struct Ticks final
+	{
+	public:
+		Tick count;
+
+		constexpr explicit Ticks(Tick count) noexcept : count(count) {}
+
+		constexpr bool await_ready() const noexcept
+		{
+			return count == 0;
+		}
+
+		void await_suspend(Timeline::Handle handle) const
+		{
+			handle.promise().scheduler->Sleep(handle.promise(), count);
+		}
+
+		constexpr void await_resume() const noexcept {}
+	};
+
+	template <typename ...TParams>
+	void *Timeline::promise_type::operator new(usize size, TimelineScheduler &scheduler, TParams &...)
+	{
+		return scheduler.AllocateFrame(size);
+	}
+
+	template <typename TOwner, typename ...TParams>
+	void *Timeline::promise_type::operator new(usize size, TOwner &, TimelineScheduler &scheduler, TParams &...)
+	{
+		return scheduler.AllocateFrame(size);
+	}
+
+	inline void *Timeline::promise_type::operator new(usize size)
+	{
+		return TimelineScheduler::AllocateUnpooledFrame(size);
+	}
+
+	inline void Timeline::promise_type::operator delete(void *frame, usize) noexcept
+	{
+		TimelineScheduler::DeallocateFrame(frame);
+	}
+}
+
+#endif // !TIMELINE_DEFINED